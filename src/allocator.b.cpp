@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "allocator.h"
+#include "benchmark.h"
+
+/* Allocator microbenchmarks.
+ * Run without MPI on a standalone Gas::Space, and compare against libc malloc/free.
+ * Usage: bench_allocator [workload...] ; no argument runs all workloads.
+ * Latencies include the cost of reading the clock (tens of ns).
+ */
+
+namespace {
+using namespace Givy;
+
+thread_local Allocator::ThreadLocalHeap thread_heap;
+Gas::Space space{Ptr (0x4000'0000'0000),      // start
+                 4096 * VMem::superpage_size, // space_by_node
+                 1,                           // nb_node
+                 0};                          // local node
+
+struct GivyAlloc {
+	static constexpr const char * name = "givy";
+	static void * allocate (size_t size) { return thread_heap.allocate (size, 1, space).ptr; }
+	static void * allocate_isolated (size_t size) {
+		return thread_heap.allocate (size, 1, space, GIVY_ALLOC_CACHE_LINE_ISOLATED).ptr;
+	}
+	static void * allocate_prefault (size_t size) {
+		return thread_heap.allocate (size, 1, space, GIVY_ALLOC_PREFAULT).ptr;
+	}
+	static void deallocate (void * p) { thread_heap.deallocate (Ptr (p), space); }
+};
+struct LibcAlloc {
+	static constexpr const char * name = "libc";
+	static void * allocate (size_t size) { return std::malloc (size); }
+	static void * allocate_isolated (size_t size) {
+		void * p = nullptr;
+		if (posix_memalign (&p, VMem::cache_line_size, Math::align_up (size, VMem::cache_line_size)))
+			return nullptr;
+		return p;
+	}
+	static void * allocate_prefault (size_t size) {
+		// No prefault option ; fault pages in with a write of each page
+		auto * p = static_cast<volatile char *> (std::malloc (size));
+		for (size_t offset = 0; offset < size; offset += VMem::page_size)
+			p[offset] = 0;
+		return const_cast<char *> (p);
+	}
+	static void deallocate (void * p) { std::free (p); }
+};
+
+// Timed operations
+template <typename A> void * timed_allocate (size_t size, latency_samples & lat) {
+	auto t = now_ns ();
+	void * p = A::allocate (size);
+	lat.add (now_ns () - t);
+	*static_cast<volatile char *> (p) = 1; // touch, and prevent malloc/free pair elision
+	return p;
+}
+template <typename A> void timed_deallocate (void * p, latency_samples & lat) {
+	auto t = now_ns ();
+	A::deallocate (p);
+	lat.add (now_ns () - t);
+}
+
+template <size_t N> struct spsc_ring {
+	// Single producer / single consumer pointer queue
+	std::array<void *, N> slots;
+	std::atomic<size_t> head{0};
+	std::atomic<size_t> tail{0};
+
+	void push (void * p) {
+		size_t t = tail.load (std::memory_order_relaxed);
+		while (t - head.load (std::memory_order_acquire) == N)
+			std::this_thread::yield ();
+		slots[t % N] = p;
+		tail.store (t + 1, std::memory_order_release);
+	}
+	void * pop (void) {
+		size_t h = head.load (std::memory_order_relaxed);
+		while (h == tail.load (std::memory_order_acquire))
+			std::this_thread::yield ();
+		void * p = slots[h % N];
+		head.store (h + 1, std::memory_order_release);
+		return p;
+	}
+};
+
+/* ----------------------------- Workloads ---------------------------------- */
+
+template <typename A> void sizeclass_loop (void) {
+	// Single thread : batches of allocations then frees, for each sizeclass
+	constexpr size_t batch = 512;
+	constexpr size_t rounds = 200;
+	std::vector<void *> ptrs (batch);
+	for (auto & info : Allocator::SizeClass::config) {
+		size_t size = std::min (info.block_size, Allocator::Thresholds::small_medium - 1);
+		char name[32];
+		std::snprintf (name, sizeof (name), "sizeclass_loop/%zu", size);
+		bench_result r{name, A::name, 2 * batch * rounds, 0, {}, current_rss (), 0};
+		r.latency.reserve (r.nb_ops);
+		auto start = now_ns ();
+		for (size_t i = 0; i < rounds; ++i) {
+			for (auto & p : ptrs)
+				p = timed_allocate<A> (size, r.latency);
+			for (auto p : ptrs)
+				timed_deallocate<A> (p, r.latency);
+		}
+		r.duration_ns = now_ns () - start;
+		r.rss_after = current_rss ();
+		r.print ();
+	}
+}
+
+template <typename A> void larson (void) {
+	/* Server-like churn : each thread owns a set of slots and repeatedly frees a random slot and
+	 * refills it with a random size.
+	 * At each epoch, slots are handed over to a new set of threads ; the previous threads are dead,
+	 * so their blocks are freed by other threads (orphaned SuperpageBlocks for givy).
+	 */
+	constexpr size_t nb_thread = 4;
+	constexpr size_t nb_slot = 1000;
+	constexpr size_t nb_epoch = 8;
+	constexpr size_t rounds = 20000;
+	constexpr size_t min_size = 8;
+	constexpr size_t max_size = 1000;
+
+	std::array<std::array<void *, nb_slot>, nb_thread> slots;
+	for (auto & th_slots : slots)
+		th_slots.fill (nullptr);
+	std::array<latency_samples, nb_thread> lats;
+
+	bench_result r{"larson", A::name, 0, 0, {}, current_rss (), 0};
+	auto start = now_ns ();
+	for (size_t epoch = 0; epoch < nb_epoch; ++epoch) {
+		std::array<std::thread, nb_thread> threads;
+		for (size_t t = 0; t < nb_thread; ++t)
+			threads[t] = std::thread ([&](size_t thid) {
+				auto & my_slots = slots[(thid + epoch) % nb_thread];
+				auto & lat = lats[thid];
+				xorshift rng (epoch * nb_thread + thid);
+				for (size_t i = 0; i < rounds; ++i) {
+					auto & slot = my_slots[rng.in (0, nb_slot)];
+					if (slot != nullptr)
+						timed_deallocate<A> (slot, lat);
+					slot = timed_allocate<A> (rng.in (min_size, max_size), lat);
+				}
+			}, t);
+		for (auto & th : threads)
+			th.join ();
+	}
+	r.duration_ns = now_ns () - start;
+	r.rss_after = current_rss ();
+	for (auto & l : lats)
+		r.latency.merge (l);
+	r.nb_ops = r.latency.samples.size ();
+	for (auto & th_slots : slots)
+		for (auto p : th_slots)
+			if (p != nullptr)
+				A::deallocate (p);
+	r.print ();
+}
+
+template <typename A> void producer_consumer (void) {
+	/* Pairs of threads : the producer allocates, the consumer frees.
+	 * For givy, every free is a remote free to the producer ThreadLocalHeap.
+	 * Producers only exit once their consumer is done, as frees target their heap.
+	 */
+	constexpr size_t nb_pair = 2;
+	constexpr size_t nb_item = 200000;
+	constexpr size_t size = 64;
+
+	std::array<spsc_ring<1024>, nb_pair> rings;
+	std::array<std::atomic<bool>, nb_pair> consumer_done;
+	for (auto & b : consumer_done)
+		b = false;
+	std::array<latency_samples, 2 * nb_pair> lats;
+
+	bench_result r{"producer_consumer", A::name, 2 * nb_pair * nb_item, 0, {}, current_rss (), 0};
+	auto start = now_ns ();
+	std::vector<std::thread> threads;
+	for (size_t pair = 0; pair < nb_pair; ++pair) {
+		threads.emplace_back ([&](size_t id) {
+			auto & lat = lats[2 * id];
+			lat.reserve (nb_item);
+			for (size_t i = 0; i < nb_item; ++i)
+				rings[id].push (timed_allocate<A> (size, lat));
+			while (!consumer_done[id].load (std::memory_order_acquire))
+				std::this_thread::yield ();
+			A::deallocate (A::allocate (size)); // Process pending remote frees
+		}, pair);
+		threads.emplace_back ([&](size_t id) {
+			auto & lat = lats[2 * id + 1];
+			lat.reserve (nb_item);
+			for (size_t i = 0; i < nb_item; ++i)
+				timed_deallocate<A> (rings[id].pop (), lat);
+			consumer_done[id].store (true, std::memory_order_release);
+		}, pair);
+	}
+	for (auto & th : threads)
+		th.join ();
+	r.duration_ns = now_ns () - start;
+	r.rss_after = current_rss ();
+	for (auto & l : lats)
+		r.latency.merge (l);
+	r.print ();
+}
+
+template <typename A> void thread_churn (void) {
+	/* Short lived threads allocate a mix of sizes and exit.
+	 * Blocks are freed by the main thread after join ; for givy this adopts orphaned
+	 * SuperpageBlocks.
+	 */
+	constexpr size_t nb_spawn = 200;
+	constexpr size_t nb_alloc = 256;
+
+	std::vector<void *> ptrs (nb_alloc);
+	latency_samples th_lat;
+	bench_result r{"thread_churn", A::name, 2 * nb_spawn * nb_alloc, 0, {}, current_rss (), 0};
+	r.latency.reserve (r.nb_ops);
+	auto start = now_ns ();
+	for (size_t spawn = 0; spawn < nb_spawn; ++spawn) {
+		std::thread ([&] {
+			xorshift rng (spawn);
+			for (auto & p : ptrs)
+				p = timed_allocate<A> (size_t (1) << rng.in (3, 16), th_lat);
+		}).join ();
+		for (auto p : ptrs)
+			timed_deallocate<A> (p, r.latency);
+	}
+	r.duration_ns = now_ns () - start;
+	r.rss_after = current_rss ();
+	r.latency.merge (th_lat);
+	r.print ();
+}
+
+template <typename A> void huge_cycles (void) {
+	// Alloc / touch / free of allocations bigger than a superpage
+	constexpr size_t rounds = 200;
+	const size_t sizes[] = {4 << 20, 16 << 20, 64 << 20};
+	for (size_t size : sizes) {
+		char name[32];
+		std::snprintf (name, sizeof (name), "huge_cycles/%zuMiB", size >> 20);
+		bench_result r{name, A::name, 2 * rounds, 0, {}, current_rss (), 0};
+		auto start = now_ns ();
+		for (size_t i = 0; i < rounds; ++i)
+			timed_deallocate<A> (timed_allocate<A> (size, r.latency), r.latency);
+		r.duration_ns = now_ns () - start;
+		r.rss_after = current_rss ();
+		r.print ();
+	}
+}
+
+template <typename A> void huge_first_touch (void) {
+	/* A huge buffer is allocated, then written by several threads (compute loop).
+	 * Without prefault, the page faults happen in the compute loop, serialized on the mm lock.
+	 * Latency samples are the allocation time, and the time of each thread write pass.
+	 */
+	constexpr size_t nb_thread = 4;
+	constexpr size_t rounds = 20;
+	constexpr size_t size = 64 << 20;
+	for (bool prefault : {false, true}) {
+		const char * name = prefault ? "huge_first_touch/prefault" : "huge_first_touch/default";
+		bench_result r{name, A::name, rounds, 0, {}, current_rss (), 0};
+		std::array<latency_samples, nb_thread> lats;
+		auto start = now_ns ();
+		for (size_t i = 0; i < rounds; ++i) {
+			auto t = now_ns ();
+			auto * buffer = static_cast<char *> (prefault ? A::allocate_prefault (size) : A::allocate (size));
+			r.latency.add (now_ns () - t);
+			std::array<std::thread, nb_thread> threads;
+			for (size_t th = 0; th < nb_thread; ++th)
+				threads[th] = std::thread ([&](size_t thid) {
+					auto t0 = now_ns ();
+					const size_t part = size / nb_thread;
+					auto * p = static_cast<volatile char *> (buffer + thid * part);
+					for (size_t offset = 0; offset < part; offset += VMem::page_size)
+						p[offset] = 1;
+					lats[thid].add (now_ns () - t0);
+				}, th);
+			for (auto & th : threads)
+				th.join ();
+			A::deallocate (buffer);
+		}
+		r.duration_ns = now_ns () - start;
+		r.rss_after = current_rss ();
+		for (auto & l : lats)
+			r.latency.merge (l);
+		r.print ();
+	}
+}
+
+template <typename A> void stride (void) {
+	/* Row-wise traversal of many same-sized objects : objects are visited by increasing offset in
+	 * their page, so objects at the same index of different page blocks follow each other.
+	 * Traversal chases a pointer stored in the first cache line of each object (dependent loads
+	 * expose cache misses).
+	 * Working set fits in L1 cache, unless objects alias to the same cache sets.
+	 * Latency samples are the duration of a full pass.
+	 */
+	constexpr size_t nb_object = 384;
+	constexpr size_t passes = 20000;
+	const size_t sizes[] = {64, 128, 256};
+	std::vector<void *> ptrs (nb_object);
+	for (size_t size : sizes) {
+		char name[32];
+		std::snprintf (name, sizeof (name), "stride/%zu", size);
+		for (auto & p : ptrs)
+			p = A::allocate (size);
+		std::sort (ptrs.begin (), ptrs.end (), [](Ptr a, Ptr b) {
+			return std::make_pair (a.p % VMem::page_size, a.p) < std::make_pair (b.p % VMem::page_size, b.p);
+		});
+		for (size_t i = 0; i < nb_object; ++i)
+			*static_cast<void **> (ptrs[i]) = ptrs[(i + 1) % nb_object];
+		bench_result r{name, A::name, nb_object * passes, 0, {}, current_rss (), 0};
+		void * volatile cursor = ptrs[0];
+		auto start = now_ns ();
+		for (size_t i = 0; i < passes; ++i) {
+			auto t = now_ns ();
+			void * p = cursor;
+			for (size_t j = 0; j < nb_object; ++j)
+				p = *static_cast<void **> (p);
+			cursor = p;
+			r.latency.add (now_ns () - t);
+		}
+		r.duration_ns = now_ns () - start;
+		r.rss_after = current_rss ();
+		r.print ();
+		for (auto p : ptrs)
+			A::deallocate (p);
+	}
+}
+
+template <typename A> void false_sharing (void) {
+	/* Each thread allocates a small counter and increments it.
+	 * Counters are allocated back to back by one thread, then handed to the workers ; without cache
+	 * line isolation they share cache lines.
+	 * Latency samples are the duration of chunks of increments.
+	 */
+	constexpr size_t nb_thread = 4;
+	constexpr size_t nb_chunk = 2000;
+	constexpr size_t chunk = 1000;
+	for (bool isolated : {false, true}) {
+		std::array<void *, nb_thread> counters;
+		for (auto & c : counters) {
+			c = isolated ? A::allocate_isolated (sizeof (long)) : A::allocate (sizeof (long));
+			*static_cast<long *> (c) = 0;
+		}
+		std::array<latency_samples, nb_thread> lats;
+		const char * name = isolated ? "false_sharing/isolated" : "false_sharing/default";
+		bench_result r{name, A::name, nb_thread * nb_chunk * chunk, 0, {}, current_rss (), 0};
+		auto start = now_ns ();
+		std::array<std::thread, nb_thread> threads;
+		for (size_t t = 0; t < nb_thread; ++t)
+			threads[t] = std::thread ([&](size_t thid) {
+				auto * counter = static_cast<volatile long *> (counters[thid]);
+				lats[thid].reserve (nb_chunk);
+				for (size_t i = 0; i < nb_chunk; ++i) {
+					auto t0 = now_ns ();
+					for (size_t j = 0; j < chunk; ++j)
+						*counter = *counter + 1;
+					lats[thid].add (now_ns () - t0);
+				}
+			}, t);
+		for (auto & th : threads)
+			th.join ();
+		r.duration_ns = now_ns () - start;
+		r.rss_after = current_rss ();
+		for (auto & l : lats)
+			r.latency.merge (l);
+		r.print ();
+		for (auto c : counters)
+			A::deallocate (c);
+	}
+}
+
+template <typename A> void fragmentation (void) {
+	/* RSS over time under steady churn.
+	 * A set of small objects is filled then mostly freed, leaving partially used page blocks.
+	 * Each phase then replaces random live objects (constant live size), and allocates a batch of
+	 * objects of another sizeclass which are kept alive. The latter can only reuse page blocks that
+	 * were completely drained by the churn ; otherwise RSS grows.
+	 */
+	constexpr size_t nb_fill = 120000;
+	constexpr size_t nb_live = nb_fill / 4;
+	constexpr size_t churn_size = 64;
+	constexpr size_t nb_phase = 10;
+	constexpr size_t churn_per_phase = 2 * nb_live;
+	constexpr size_t grow_per_phase = 4000;
+	constexpr size_t grow_size = 256;
+
+	xorshift rng (42);
+	std::vector<void *> fill (nb_fill);
+	std::vector<void *> live;
+	std::vector<void *> grown;
+	live.reserve (nb_live);
+	grown.reserve (nb_phase * grow_per_phase);
+
+	bench_result r{"fragmentation", A::name, 0, 0, {}, 0, 0};
+	// Touch the sample storage beforehand, so that it does not show in the RSS of phases
+	r.latency.samples.resize (2 * nb_fill + nb_phase * (2 * churn_per_phase + grow_per_phase));
+	r.latency.samples.clear ();
+	grown.resize (grown.capacity ());
+	grown.clear ();
+	r.rss_before = current_rss ();
+	auto start = now_ns ();
+	for (auto & p : fill)
+		p = timed_allocate<A> (churn_size, r.latency);
+	for (size_t i = 0; i < nb_fill; ++i)
+		std::swap (fill[i], fill[rng.in (i, nb_fill)]);
+	for (size_t i = 0; i < nb_fill; ++i)
+		if (i < nb_live)
+			live.push_back (fill[i]);
+		else
+			timed_deallocate<A> (fill[i], r.latency);
+	for (size_t phase = 0; phase < nb_phase; ++phase) {
+		for (size_t i = 0; i < churn_per_phase; ++i) {
+			auto & slot = live[rng.in (0, nb_live)];
+			timed_deallocate<A> (slot, r.latency);
+			slot = timed_allocate<A> (churn_size, r.latency);
+		}
+		for (size_t i = 0; i < grow_per_phase; ++i)
+			grown.push_back (timed_allocate<A> (grow_size, r.latency));
+		std::printf ("fragmentation/phase%-14zu %-6s live=%7zuKiB rss=%7zuKiB\n", phase, A::name,
+		             (nb_live * churn_size + grown.size () * grow_size) / 1024,
+		             current_rss () / 1024);
+	}
+	r.duration_ns = now_ns () - start;
+	r.rss_after = current_rss ();
+	r.nb_ops = r.latency.samples.size ();
+	for (auto p : live)
+		A::deallocate (p);
+	for (auto p : grown)
+		A::deallocate (p);
+	r.print ();
+}
+
+template <typename A> void run_all (int argc, char * argv[]) {
+	if (bench_selected (argc, argv, "sizeclass_loop"))
+		sizeclass_loop<A> ();
+	if (bench_selected (argc, argv, "larson"))
+		larson<A> ();
+	if (bench_selected (argc, argv, "producer_consumer"))
+		producer_consumer<A> ();
+	if (bench_selected (argc, argv, "thread_churn"))
+		thread_churn<A> ();
+	if (bench_selected (argc, argv, "huge_cycles"))
+		huge_cycles<A> ();
+	if (bench_selected (argc, argv, "huge_first_touch"))
+		huge_first_touch<A> ();
+	if (bench_selected (argc, argv, "stride"))
+		stride<A> ();
+	if (bench_selected (argc, argv, "false_sharing"))
+		false_sharing<A> ();
+	if (bench_selected (argc, argv, "fragmentation"))
+		fragmentation<A> ();
+}
+}
+
+int main (int argc, char * argv[]) {
+	// RSS is process wide : compare the per workload deltas
+	run_all<LibcAlloc> (argc, argv);
+	run_all<GivyAlloc> (argc, argv);
+	return 0;
+}
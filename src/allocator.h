@@ -95,19 +95,44 @@ namespace Allocator {
 			return Math::log_2_sup (size) - min_sizeclass_log;
 		}
 
+		/* Cache line coloring.
+		 * Blocks are power of 2 sized and page blocks start on page boundaries, so blocks at the same
+		 * index of different page blocks would map to the same cache sets.
+		 * If a page block has slack (space not used by blocks), carving starts at a cache line offset
+		 * (color), chosen in rotation for each new page block.
+		 * Only offsets in [0, block_size[ are useful, as other offsets alias to them.
+		 *
+		 * Blocks up to one cache line already use every cache line of the page block.
+		 * Bigger blocks up to max_colored_block_size sacrifice one block to get slack.
+		 * Colored blocks are only aligned to cache_line_size.
+		 */
+		constexpr size_t max_colored_block_size = VMem::page_size / 16;
+
 		/* Sizeclass configuration (precomputed at compile time).
 		 */
 		struct Info {
 			size_t block_size;      // Size of sizeclass
 			size_t page_block_size; // Size of PageBlocks of this sizeclass
 			size_t nb_blocks;       // Total number of blocks than can fit in a PageBlock
+			size_t nb_colors;       // Number of cache line offsets that can start a PageBlock
+			size_t block_align;     // Alignment guaranteed for blocks
 			Id sc_id;               // sizeclass id
 		};
 
 		constexpr Info make_info (size_t nth_sizeclass) {
 			// TODO more page blocks on bigger sizeclasses
 			size_t bs = size_t (1) << (nth_sizeclass + min_sizeclass_log);
-			return {bs, 1, VMem::page_size / bs, Id (nth_sizeclass)};
+			size_t pb_size = 1;
+			size_t pb_bytes = pb_size * VMem::page_size;
+			size_t nb_blocks = pb_bytes / bs;
+			if (VMem::cache_line_size < bs && bs <= max_colored_block_size)
+				nb_blocks--;
+			size_t slack = pb_bytes - nb_blocks * bs;
+			size_t nb_colors = std::max (std::min (slack / VMem::cache_line_size + 1,
+			                                       bs / VMem::cache_line_size),
+			                             size_t (1));
+			size_t block_align = nb_colors > 1 ? VMem::cache_line_size : bs;
+			return {bs, pb_size, nb_blocks, nb_colors, block_align, Id (nth_sizeclass)};
 		}
 
 		constexpr auto config = static_array_from_generator<nb_sizeclass> (make_info);
@@ -117,11 +142,39 @@ namespace Allocator {
 
 		/* Sizeclass specific page block lists.
 		 * All active (non empty & not full) Small page blocks are threaded into their corresponding
-		 * sizeclass list.
+		 * sizeclass lists.
+		 *
+		 * Each sizeclass has nb_occupancy_bucket lists, by fraction of used blocks in the page block.
+		 * Allocation takes blocks from the fullest page blocks ; nearly empty page blocks are then
+		 * only touched by deallocations, and will be drained and released.
 		 */
 		struct ActivePageBlockListTag;
 		using ActivePageBlockList = Intrusive::List<PageBlockHeader, ActivePageBlockListTag>;
 
+		constexpr size_t nb_occupancy_bucket = 4;
+		using OccupancyBucket = BoundUint<nb_occupancy_bucket>;
+
+		class ActivePageBlocks {
+		private:
+			ActivePageBlockList buckets[nb_occupancy_bucket];
+
+		public:
+			bool empty (void) const;
+			PageBlockHeader & fullest (void);
+
+			// Page block occupancy must be up to date
+			void insert (PageBlockHeader & pbh, const Info & info);
+			void update (PageBlockHeader & pbh, const Info & info);
+			static void remove (PageBlockHeader & pbh);
+
+#ifdef ASSERT_SAFE_ENABLED
+			template <typename Callable> void for_each (Callable && callable) const;
+#endif
+
+		private:
+			static size_t bucket (const PageBlockHeader & pbh, const Info & info);
+		};
+
 #ifdef ASSERT_SAFE_ENABLED
 		void print (void);
 #endif
@@ -142,8 +195,8 @@ namespace Allocator {
 		 * SuperpageBlock.
 		 *
 		 * An active PageBlockHeader of type Small is the only kind of PageBlockHeader that can be in a
-		 * SizeClass::ActivePageBlockList.
-		 * It will be in the list of its sizeclass if and only if it is neither full nor empty.
+		 * SizeClass::ActivePageBlocks.
+		 * It will be in the lists of its sizeclass if and only if it is neither full nor empty.
 		 *
 		 * Unused page blocks which are neighbours will be merged.
 		 */
@@ -155,10 +208,19 @@ namespace Allocator {
 		PageBlockHeader * head; // pointer to active header representing the page block
 
 		SizeClass::Id sb_sizeclass;
+		SizeClass::OccupancyBucket sb_occupancy_bucket; // Bucket in SizeClass::ActivePageBlocks
+		BoundUint<VMem::page_size> sb_color_offset;     // Start of first block in page block
 		BoundUint<SizeClass::max_nb_blocks> sb_nb_carved;
 		BoundUint<SizeClass::max_nb_blocks> sb_nb_unused;
 		BlockFreeList sb_unused;
 
+		/* Coherence metadata of the regions of the page block (opaque to the allocator).
+		 * Medium, Huge: metadata of the page block region.
+		 * Small: side array of metadata indexed by block number, created at first use and destroyed
+		 * with the page block.
+		 */
+		std::atomic<void *> region_metadata;
+
 	public:
 		Ptr page_block (void) const;
 
@@ -167,10 +229,17 @@ namespace Allocator {
 
 		// Small blocks
 		size_t available_small_blocks (const SizeClass::Info & info) const;
-		void configure_small_blocks (const SizeClass::Info & info);
+		void configure_small_blocks (const SizeClass::Info & info, size_t color);
 
 		Ptr take_small_block (const SizeClass::Info & info);
 		void put_small_block (Ptr p, const SizeClass::Info & info);
+		Ptr small_block_start (Ptr p, const SizeClass::Info & info) const;
+
+		// Region metadata
+		std::atomic<void *> & small_block_region_metadata (Ptr p, const SizeClass::Info & info);
+		std::atomic<void *> * find_small_block_region_metadata (Ptr p, const SizeClass::Info & info);
+		void clear_small_block_region_metadata (Ptr p, const SizeClass::Info & info);
+		void release_region_metadata (void);
 
 #ifdef ASSERT_SAFE_ENABLED
 	public:
@@ -219,6 +288,7 @@ namespace Allocator {
 		size_t superpage_nb;
 
 		size_t huge_alloc_pb_index;
+		std::atomic<void *> huge_alloc_region_metadata{nullptr};
 		PageBlockUnusedList unused;
 		PageBlockHeader pbh_table[VMem::superpage_page_nb];
 
@@ -258,6 +328,16 @@ namespace Allocator {
 		bool all_page_blocks_unused (void) const; // excluding Huge & Reserved
 		size_t available_pb_index (void) const;
 
+		/* Region metadata slot : opaque pointer for the coherence metadata of the allocated region
+		 * containing p, nullptr initially. Valid as long as the region is allocated.
+		 */
+		std::atomic<void *> & region_metadata_slot (Ptr p);
+		// Without creating any storage : nullptr if the slot was never created (so is nullptr)
+		std::atomic<void *> * find_region_metadata_slot (Ptr p);
+
+		// Memory of the allocated region containing p (whole small block, page block or huge alloc)
+		Block region_memory (Ptr p);
+
 		/* Owner */
 		ThreadLocalHeap * get_owner (void) const;
 		void disown (void);
@@ -306,6 +386,10 @@ namespace Allocator {
 		 *
 		 * Thread remote frees are managed by pushing them on the remote_freed_blocks list of the owner
 		 * ThreadLocalHeap.
+		 * Remotely freed small blocks are then kept in reusable_small_blocks by sizeclass, and served
+		 * to the next small allocations without touching the page block metadata (they still count as
+		 * used in their page block). They are given back to their page blocks in batches, when a
+		 * sizeclass list grows longer than a page block.
 		 *
 		 * TODO notify system : atomic_bool to trigger process_thread_remote_frees, and
 		 * switch-from-local-to-gas-mode cleanup
@@ -313,7 +397,30 @@ namespace Allocator {
 	private:
 		SuperpageBlockOwnedList owned_superpage_blocks;
 		ThreadRemoteFreeList remote_freed_blocks;
-		SizeClass::ActivePageBlockList active_small_page_blocks[SizeClass::nb_sizeclass];
+		SizeClass::ActivePageBlocks active_small_page_blocks[SizeClass::nb_sizeclass];
+		size_t next_small_page_block_color[SizeClass::nb_sizeclass] = {};
+		BlockFreeList reusable_small_blocks[SizeClass::nb_sizeclass];
+		size_t nb_reusable_small_blocks[SizeClass::nb_sizeclass] = {};
+
+		// Space of the last allocator call, for cleanups on heap death ; nullptr if never used
+		Gas::Space * last_space{nullptr};
+
+		/* Next-fit position for superpage reservation, as an offset in the local GAS interval.
+		 * Heaps start at different stripes so that concurrent reservations do not compete for the
+		 * same superpage tracker cells.
+		 */
+		static constexpr size_t superpage_search_stripe = 64;
+		size_t superpage_search_cursor;
+
+		/* Chunk of reserved local superpages, handed out as 1 superpage SPBs.
+		 * Reserving superpage_chunk_size superpages at once amortizes the tracker search and the
+		 * mapping syscall while a heap ramps up. Multi superpage SPBs are reserved directly.
+		 * The unused part is given back on heap death, or when a reservation does not fit anymore.
+		 */
+		static constexpr size_t superpage_chunk_size = 16;
+		Ptr superpage_chunk_next{nullptr};
+		size_t superpage_chunk_remaining{0};
+		Gas::Space * superpage_chunk_space{nullptr};
 
 	public:
 		/* Constructors and destructors are called on thread creation / destruction due to the use of
@@ -325,25 +432,32 @@ namespace Allocator {
 
 		/* Allocation interface.
 		 *
+		 * flags is a combination of givy_alloc_flags.
 		 * deallocate supports pointers inside the allocation.
 		 */
-		Block allocate (size_t size, size_t align, Gas::Space & space);
+		Block allocate (size_t size, size_t align, Gas::Space & space,
+		                unsigned flags = GIVY_ALLOC_DEFAULT);
 		void deallocate (Ptr ptr, Gas::Space & space);
 		void deallocate (Block blk, Gas::Space & space);
 
 	private:
-		SuperpageBlock & create_superpage_block (size_t huge_alloc_size, Gas::Space & space);
+		Ptr reserve_superpage_sequence (size_t superpage_nb, Gas::Space & space, bool prefault);
+		void release_superpage_chunk (void);
+
+		SuperpageBlock & create_superpage_block (size_t huge_alloc_size, Gas::Space & space,
+		                                         bool prefault = false);
 		void destroy_superpage_block (SuperpageBlock & spb, Gas::Space & space);
 		void destroy_superpage_huge_alloc (SuperpageBlock & spb, Gas::Space & space);
 
 		PageBlockHeader & create_page_block (size_t nb_page, MemoryType type, Gas::Space & space);
 		void destroy_page_block (PageBlockHeader & pbh, SuperpageBlock & spb, Gas::Space & space);
-		Block allocate_small_block (size_t size, Gas::Space & space);
+		Block allocate_small_block (size_t size, size_t align, Gas::Space & space);
 		void destroy_small_block (Ptr ptr, PageBlockHeader & pbh, SuperpageBlock & spb,
 		                          Gas::Space & space);
 
 		void thread_local_deallocate (Ptr ptr, SuperpageBlock & spb, Gas::Space & space);
 		void process_thread_remote_frees (Gas::Space & space);
+		void flush_reusable_small_blocks (size_t sc_id, Gas::Space & space);
 
 #ifdef ASSERT_SAFE_ENABLED
 	public:
@@ -354,12 +468,61 @@ namespace Allocator {
 	/* ---------------------------- SizeClass IMPL -------------------------------- */
 
 	namespace SizeClass {
+		inline bool ActivePageBlocks::empty (void) const {
+			for (auto & list : buckets)
+				if (!list.empty ())
+					return false;
+			return true;
+		}
+
+		inline PageBlockHeader & ActivePageBlocks::fullest (void) {
+			ASSERT_SAFE (!empty ());
+			size_t b = nb_occupancy_bucket - 1;
+			while (buckets[b].empty ())
+				b--;
+			return buckets[b].front ();
+		}
+
+		inline void ActivePageBlocks::insert (PageBlockHeader & pbh, const Info & info) {
+			pbh.sb_occupancy_bucket = bucket (pbh, info);
+			buckets[pbh.sb_occupancy_bucket].push_front (pbh);
+		}
+
+		inline void ActivePageBlocks::update (PageBlockHeader & pbh, const Info & info) {
+			// Only move if the page block changed bucket
+			size_t b = bucket (pbh, info);
+			if (b != pbh.sb_occupancy_bucket) {
+				ActivePageBlockList::unlink (pbh);
+				pbh.sb_occupancy_bucket = b;
+				buckets[b].push_front (pbh);
+			}
+		}
+
+		inline void ActivePageBlocks::remove (PageBlockHeader & pbh) {
+			ActivePageBlockList::unlink (pbh);
+		}
+
+		inline size_t ActivePageBlocks::bucket (const PageBlockHeader & pbh, const Info & info) {
+			size_t used = info.nb_blocks - pbh.available_small_blocks (info);
+			ASSERT_SAFE (used < info.nb_blocks);
+			return (used * nb_occupancy_bucket) / info.nb_blocks;
+		}
+
 #ifdef ASSERT_SAFE_ENABLED
+		template <typename Callable>
+		inline void ActivePageBlocks::for_each (Callable && callable) const {
+			// From fullest to emptiest
+			for (size_t b = nb_occupancy_bucket; b > 0; --b)
+				for (auto & pbh : buckets[b - 1])
+					callable (pbh);
+		}
+
 		inline void print (void) {
 			printf ("SizeClass config (max_nb_blocks = %zu):\n", max_nb_blocks);
 			for (auto & info : config)
-				printf ("[%zu] bs=%zu, pb_size=%zu, nb_block=%zu\n", size_t (info.sc_id), info.block_size,
-				        info.page_block_size, info.nb_blocks);
+				printf ("[%zu] bs=%zu, pb_size=%zu, nb_block=%zu, nb_colors=%zu, align=%zu\n",
+				        size_t (info.sc_id), info.block_size, info.page_block_size, info.nb_blocks,
+				        info.nb_colors, info.block_align);
 		}
 #endif
 	}
@@ -374,14 +537,16 @@ namespace Allocator {
 		type = type_;
 		nb_page = pb_size;
 		head = head_;
+		region_metadata.store (nullptr, std::memory_order_relaxed);
 	}
 
 	inline size_t PageBlockHeader::available_small_blocks (const SizeClass::Info & info) const {
 		return sb_nb_unused + (info.nb_blocks - sb_nb_carved);
 	}
 
-	inline void PageBlockHeader::configure_small_blocks (const SizeClass::Info & info) {
+	inline void PageBlockHeader::configure_small_blocks (const SizeClass::Info & info, size_t color) {
 		sb_sizeclass = info.sc_id;
+		sb_color_offset = (color % info.nb_colors) * VMem::cache_line_size;
 		sb_nb_carved = 0;
 		sb_nb_unused = 0;
 		sb_unused.clear ();
@@ -397,29 +562,84 @@ namespace Allocator {
 			return p;
 		} else {
 			// Carve new block
-			Ptr p = page_block () + info.block_size * sb_nb_carved;
+			Ptr p = page_block () + sb_color_offset + info.block_size * sb_nb_carved;
 			sb_nb_carved++;
 			return p;
 		}
 	}
 
 	inline void PageBlockHeader::put_small_block (Ptr p, const SizeClass::Info & info) {
-		ASSERT_SAFE (page_block () <= p);
-		ASSERT_SAFE (p < page_block () + VMem::page_size * size ());
-
-		/* Thread block in freelist ; align ptr to block boundary in case p is not at block_start.
-		 */
-		UnusedBlock * blk = new (p.align (info.block_size)) UnusedBlock;
+		// Thread block in freelist ; p may not be at block start
+		clear_small_block_region_metadata (p, info);
+		UnusedBlock * blk = new (small_block_start (p, info)) UnusedBlock;
 		sb_unused.push_front (*blk);
 		sb_nb_unused++;
 	}
 
+	inline Ptr PageBlockHeader::small_block_start (Ptr p, const SizeClass::Info & info) const {
+		Ptr blocks_start = page_block () + sb_color_offset;
+		ASSERT_SAFE (blocks_start <= p);
+		ASSERT_SAFE (p < blocks_start + info.block_size * info.nb_blocks);
+		return blocks_start + Math::align (p - blocks_start, info.block_size);
+	}
+
+	inline std::atomic<void *> &
+	PageBlockHeader::small_block_region_metadata (Ptr p, const SizeClass::Info & info) {
+		/* The side array is created by the first user ; concurrent creators race with a CAS.
+		 * Acquire/release : array slots are initialized before the array is seen.
+		 */
+		using Slot = std::atomic<void *>;
+		auto * slots = static_cast<Slot *> (region_metadata.load (std::memory_order_acquire));
+		if (slots == nullptr) {
+			auto blk = Bootstrap ().allocate (info.nb_blocks * sizeof (Slot), alignof (Slot));
+			auto * created = static_cast<Slot *> (blk.ptr);
+			for (size_t i = 0; i < info.nb_blocks; ++i)
+				new (&created[i]) Slot (nullptr);
+			void * expected = nullptr;
+			if (region_metadata.compare_exchange_strong (expected, created, std::memory_order_acq_rel,
+			                                             std::memory_order_acquire)) {
+				slots = created;
+			} else {
+				Bootstrap ().deallocate (blk);
+				slots = static_cast<Slot *> (expected);
+			}
+		}
+		Ptr blocks_start = page_block () + sb_color_offset;
+		return slots[(small_block_start (p, info) - blocks_start) / info.block_size];
+	}
+	inline std::atomic<void *> *
+	PageBlockHeader::find_small_block_region_metadata (Ptr p, const SizeClass::Info & info) {
+		// Does not create the side array
+		using Slot = std::atomic<void *>;
+		auto * slots = static_cast<Slot *> (region_metadata.load (std::memory_order_acquire));
+		if (slots == nullptr)
+			return nullptr;
+		Ptr blocks_start = page_block () + sb_color_offset;
+		return &slots[(small_block_start (p, info) - blocks_start) / info.block_size];
+	}
+
+	inline void PageBlockHeader::clear_small_block_region_metadata (Ptr p,
+	                                                                const SizeClass::Info & info) {
+		// On block deallocation ; does not create the side array
+		if (auto * slot = find_small_block_region_metadata (p, info))
+			slot->store (nullptr, std::memory_order_relaxed);
+	}
+
+	inline void PageBlockHeader::release_region_metadata (void) {
+		void * p = region_metadata.exchange (nullptr, std::memory_order_acquire);
+		if (type == MemoryType::small && p != nullptr) {
+			auto & info = SizeClass::config[sb_sizeclass];
+			Bootstrap ().deallocate ({p, info.nb_blocks * sizeof (std::atomic<void *>)});
+		}
+	}
+
 #ifdef ASSERT_SAFE_ENABLED
 	inline void PageBlockHeader::print (void) const {
 		if (type == MemoryType::small) {
 			auto & info = SizeClass::config[sb_sizeclass];
-			printf ("Small [S=%zu,sc=%zu,bs=%zu,cvd=%zu/%zu,un=%zu]\n", size (), size_t (sb_sizeclass),
-			        info.block_size, size_t (sb_nb_carved), info.nb_blocks, size_t (sb_nb_unused));
+			printf ("Small [S=%zu,sc=%zu,bs=%zu,off=%zu,cvd=%zu/%zu,un=%zu]\n", size (),
+			        size_t (sb_sizeclass), info.block_size, size_t (sb_color_offset),
+			        size_t (sb_nb_carved), info.nb_blocks, size_t (sb_nb_unused));
 		} else if (type == MemoryType::medium) {
 			printf ("Medium [S=%zu]\n", size ());
 		} else if (type == MemoryType::huge) {
@@ -502,6 +722,7 @@ namespace Allocator {
 		 */
 		if (huge_alloc_pb_index < VMem::superpage_page_nb)
 			free_page_block (pbh_table[huge_alloc_pb_index]);
+		huge_alloc_region_metadata.store (nullptr, std::memory_order_relaxed);
 
 		// Trim
 		superpage_nb = 1;
@@ -529,6 +750,7 @@ namespace Allocator {
 	}
 
 	inline void SuperpageBlock::free_page_block (PageBlockHeader & pbh) {
+		pbh.release_region_metadata ();
 		PageBlockHeader * start = &pbh;
 		PageBlockHeader * end = start + pbh.size ();
 		PageBlockHeader * const table_start = pbh_table;
@@ -573,6 +795,51 @@ namespace Allocator {
 		return *page_block_header (pb_index).head;
 	}
 
+	inline std::atomic<void *> & SuperpageBlock::region_metadata_slot (Ptr p) {
+		if (in_huge_alloc (p))
+			return huge_alloc_region_metadata;
+		auto & pbh = page_block_header (p);
+		if (pbh.type == MemoryType::small)
+			return pbh.small_block_region_metadata (p, SizeClass::config[pbh.sb_sizeclass]);
+		ASSERT_SAFE (pbh.type == MemoryType::medium);
+		return pbh.region_metadata;
+	}
+	inline std::atomic<void *> * SuperpageBlock::find_region_metadata_slot (Ptr p) {
+		if (in_huge_alloc (p))
+			return &huge_alloc_region_metadata;
+		auto & pbh = page_block_header (p);
+		if (pbh.type == MemoryType::small)
+			return pbh.find_small_block_region_metadata (p, SizeClass::config[pbh.sb_sizeclass]);
+		ASSERT_SAFE (pbh.type == MemoryType::medium);
+		return &pbh.region_metadata;
+	}
+
+	inline Block SuperpageBlock::region_memory (Ptr p) {
+		if (in_huge_alloc (p))
+			return huge_alloc_memory ();
+		auto & pbh = page_block_header (p);
+		if (pbh.type == MemoryType::small) {
+			auto & info = SizeClass::config[pbh.sb_sizeclass];
+			return {pbh.small_block_start (p, info), info.block_size};
+		}
+		ASSERT_SAFE (pbh.type == MemoryType::medium);
+		return page_block_memory (pbh);
+	}
+
+	inline std::atomic<void *> & region_metadata_slot (Ptr p, const Gas::Space & space) {
+		// For regions of the local interval
+		return space.superpage_sequence_start (p).as_ref<SuperpageBlock> ().region_metadata_slot (p);
+	}
+	inline std::atomic<void *> * find_region_metadata_slot (Ptr p, const Gas::Space & space) {
+		// For regions of the local interval ; lookup only, never allocates
+		return space.superpage_sequence_start (p).as_ref<SuperpageBlock> ().find_region_metadata_slot (
+		    p);
+	}
+	inline Block region_memory (Ptr p, const Gas::Space & space) {
+		// For regions of the local interval
+		return space.superpage_sequence_start (p).as_ref<SuperpageBlock> ().region_memory (p);
+	}
+
 	inline bool SuperpageBlock::all_page_blocks_unused (void) const {
 		// Test if unused quicklist contains every page (except Reserved and Huge ones)
 		return unused.size () == available_pb_index () - header_space_pages;
@@ -631,44 +898,70 @@ namespace Allocator {
 
 	/* ---------------------------- ThreadLocalHeap IMPL -------------------------- */
 
-	inline ThreadLocalHeap::ThreadLocalHeap () { DEBUG_TEXT ("[%p]ThreadLocalHeap()\n", this); }
+	inline ThreadLocalHeap::ThreadLocalHeap () {
+		DEBUG_TEXT ("[%p]ThreadLocalHeap()\n", this);
+		static std::atomic<size_t> next_stripe{0};
+		superpage_search_cursor =
+		    next_stripe.fetch_add (1, std::memory_order_relaxed) * superpage_search_stripe;
+	}
 
 	inline ThreadLocalHeap::~ThreadLocalHeap () {
 		DEBUG_TEXT ("[%p]~ThreadLocalHeap()\n", this);
 
-		// process_thread_remote_frees ();
-		// FIXME cannot call it as we don't store gas_space
+		release_superpage_chunk ();
+
+		/* Give remotely freed and reusable blocks back to their page blocks.
+		 * Emptied page blocks are destroyed, as the SPB may never be touched (and adopted) again.
+		 * Reusable blocks only exist if the heap was used, so last_space is set.
+		 */
+		if (last_space != nullptr) {
+			process_thread_remote_frees (*last_space);
+			for (size_t sc_id = 0; sc_id < SizeClass::nb_sizeclass; ++sc_id)
+				flush_reusable_small_blocks (sc_id, *last_space);
+		}
 
 		// Disown pages to let them be picked up by another ThreadLocalHeap
 		while (!owned_superpage_blocks.empty ()) {
 			auto & spb = owned_superpage_blocks.front ();
 			owned_superpage_blocks.pop_front ();
 
-			// remove page blocks from active sizeclass list
+			// remove page blocks from active sizeclass lists
 			for (size_t i = 0; i < VMem::superpage_page_nb; i += spb.page_block_header (i).size ())
 				if (spb.page_block_header (i).type == MemoryType::small)
-					SizeClass::ActivePageBlockList::unlink (spb.page_block_header (i));
+					SizeClass::ActivePageBlocks::remove (spb.page_block_header (i));
 
 			spb.disown ();
 		}
 	}
 
-	inline Block ThreadLocalHeap::allocate (size_t size, size_t align, Gas::Space & space) {
+	inline Block ThreadLocalHeap::allocate (size_t size, size_t align, Gas::Space & space,
+	                                       unsigned flags) {
+		last_space = &space;
 		process_thread_remote_frees (space);
 
+		/* Cache line isolation.
+		 * Padding the size to whole cache lines and aligning to a cache line is enough : small blocks
+		 * are then at least cache line sized and aligned (power of 2 sizeclasses), and bigger
+		 * allocations use whole pages.
+		 */
+		if (flags & GIVY_ALLOC_CACHE_LINE_ISOLATED) {
+			size = Math::align_up (size, VMem::cache_line_size);
+			align = std::max (align, VMem::cache_line_size);
+		}
+
 		/* Alignment support.
-		 * Small allocations are aligned to the size of the sizeclass.
+		 * Small allocations are aligned to the block_align of the sizeclass.
 		 * All other allocations are aligned to pages.
 		 * So we allow a simple support of up to page-size alignement, by using a size of at least
-		 * requested alignement to answer the allocate request.
+		 * requested alignement to answer the allocate request, and a sizeclass with enough alignment.
 		 */
 		ASSERT_STD (align <= VMem::page_size);
 		ASSERT_STD (Math::is_power_of_2 (align));
-		size = std::max (size, align); // TODO find small block aligned
+		size = std::max (size, align);
 
 		if (size < Thresholds::small_medium) {
 			// Small alloc
-			return allocate_small_block (size, space);
+			return allocate_small_block (size, align, space);
 		} else if (size < Thresholds::medium_high) {
 			// Big alloc
 			size_t page_nb = Math::divide_up (size, VMem::page_size);
@@ -676,11 +969,13 @@ namespace Allocator {
 			return SuperpageBlock::from_pbh (pbh).page_block_memory (pbh);
 		} else {
 			// Huge alloc
-			return create_superpage_block (size, space).huge_alloc_memory ();
+			bool prefault = flags & GIVY_ALLOC_PREFAULT;
+			return create_superpage_block (size, space, prefault).huge_alloc_memory ();
 		}
 	}
 
 	inline void ThreadLocalHeap::deallocate (Ptr ptr, Gas::Space & space) {
+		last_space = &space;
 		process_thread_remote_frees (space);
 
 		auto & spb = space.superpage_sequence_start (ptr).as_ref<SuperpageBlock> ();
@@ -692,11 +987,14 @@ namespace Allocator {
 		 */
 		if (owner == nullptr && spb.adopt (this)) {
 			owned_superpage_blocks.push_back (spb);
-			// Add active page blocks to sizeclass active lists
+			// Add active (not full) page blocks to sizeclass active lists
 			for (size_t i = 0; i < VMem::superpage_page_nb; i += spb.page_block_header (i).size ()) {
 				auto & pbh = spb.page_block_header (i);
-				if (pbh.type == MemoryType::small)
-					active_small_page_blocks[pbh.sb_sizeclass].push_back (pbh);
+				if (pbh.type != MemoryType::small)
+					continue;
+				auto & info = SizeClass::config[pbh.sb_sizeclass];
+				if (pbh.available_small_blocks (info) > 0)
+					active_small_page_blocks[pbh.sb_sizeclass].insert (pbh, info);
 			}
 			owner = this;
 		}
@@ -727,20 +1025,63 @@ namespace Allocator {
 	}
 
 	inline SuperpageBlock & ThreadLocalHeap::create_superpage_block (size_t huge_alloc_size,
-	                                                                 Gas::Space & space) {
+	                                                                 Gas::Space & space,
+	                                                                 bool prefault) {
 		/* Compute sizes
 		 * If huge_alloc_size is 0, allocates just one superpage
+		 * If prefault is set, all pages of the sequence are faulted in before returning.
 		 */
 		size_t huge_alloc_page_nb = Math::divide_up (huge_alloc_size, VMem::page_size);
 		size_t superpage_nb = Math::divide_up (huge_alloc_page_nb + SuperpageBlock::header_space_pages,
 		                                       VMem::superpage_page_nb);
 		// Reserve & map, configure, register
-		auto base = space.reserve_local_superpage_sequence (superpage_nb);
+		auto base = reserve_superpage_sequence (superpage_nb, space, prefault);
 		auto & spb = *new (base) SuperpageBlock (superpage_nb, huge_alloc_page_nb, this);
 		owned_superpage_blocks.push_back (spb);
 		return spb;
 	}
 
+	inline Ptr ThreadLocalHeap::reserve_superpage_sequence (size_t superpage_nb, Gas::Space & space,
+	                                                        bool prefault) {
+		if (superpage_nb == 1) {
+			// Refill the chunk if needed ; fall back to a single superpage if the chunk does not fit
+			if (superpage_chunk_remaining == 0 || superpage_chunk_space != &space) {
+				release_superpage_chunk ();
+				Ptr chunk =
+				    space.try_reserve_local_superpage_sequence (superpage_chunk_size, superpage_search_cursor);
+				if (chunk == Ptr (nullptr))
+					return space.reserve_local_superpage_sequence (1, superpage_search_cursor, prefault);
+				space.split_superpage_sequence (chunk, superpage_chunk_size);
+				superpage_chunk_next = chunk;
+				superpage_chunk_remaining = superpage_chunk_size;
+				superpage_chunk_space = &space;
+			}
+			Ptr base = superpage_chunk_next;
+			superpage_chunk_next += VMem::superpage_size;
+			superpage_chunk_remaining--;
+			if (prefault)
+				space.prefault_superpage_sequence (base, 1);
+			return base;
+		} else {
+			Ptr base = space.try_reserve_local_superpage_sequence (superpage_nb, superpage_search_cursor,
+			                                                       prefault);
+			if (base == Ptr (nullptr)) {
+				// Memory pressure : give back our unused superpages, they may complete a free sequence
+				release_superpage_chunk ();
+				base = space.reserve_local_superpage_sequence (superpage_nb, superpage_search_cursor,
+				                                               prefault);
+			}
+			return base;
+		}
+	}
+
+	inline void ThreadLocalHeap::release_superpage_chunk (void) {
+		if (superpage_chunk_remaining > 0)
+			superpage_chunk_space->release_superpage_sequence (superpage_chunk_next,
+			                                                   superpage_chunk_remaining);
+		superpage_chunk_remaining = 0;
+	}
+
 	inline void ThreadLocalHeap::destroy_superpage_block (SuperpageBlock & spb, Gas::Space & space) {
 		owned_superpage_blocks.remove (spb);
 		auto base = spb.ptr ();
@@ -780,24 +1121,41 @@ namespace Allocator {
 			destroy_superpage_block (spb, space);
 	}
 
-	inline Block ThreadLocalHeap::allocate_small_block (size_t size, Gas::Space & space) {
-		auto & info = SizeClass::config[SizeClass::id (std::max (size, Thresholds::smallest))];
-		auto & pb_list = active_small_page_blocks[info.sc_id];
+	inline Block ThreadLocalHeap::allocate_small_block (size_t size, size_t align,
+	                                                    Gas::Space & space) {
+		// Colored sizeclasses have a weaker alignment ; use the next big enough sizeclass
+		size_t sc_id = SizeClass::id (std::max (size, Thresholds::smallest));
+		while (SizeClass::config[sc_id].block_align < align)
+			sc_id++;
+		auto & info = SizeClass::config[sc_id];
+
+		// Reuse remotely freed blocks first ; they are still counted as used by their page block
+		auto & reusable = reusable_small_blocks[info.sc_id];
+		if (!reusable.empty ()) {
+			Ptr p = reusable.front ().ptr ();
+			reusable.pop_front ();
+			nb_reusable_small_blocks[info.sc_id]--;
+			return {p, info.block_size};
+		}
+
+		auto & active = active_small_page_blocks[info.sc_id];
 
 		// Create new page block if there is none available.
-		if (pb_list.empty ()) {
+		if (active.empty ()) {
 			auto & new_pbh = create_page_block (info.page_block_size, MemoryType::small, space);
-			new_pbh.configure_small_blocks (info);
-			pb_list.push_front (new_pbh);
+			new_pbh.configure_small_blocks (info, next_small_page_block_color[info.sc_id]++);
+			active.insert (new_pbh, info);
 		}
 
-		// Pick block from current page block
-		auto & pbh = pb_list.front ();
+		// Pick block from the fullest page block
+		auto & pbh = active.fullest ();
 		Ptr p = pbh.take_small_block (info);
 
-		// Remove from list if empty
+		// Remove from lists if full
 		if (pbh.available_small_blocks (info) == 0)
-			pb_list.pop_front ();
+			SizeClass::ActivePageBlocks::remove (pbh);
+		else
+			active.update (pbh, info);
 
 		return {p, info.block_size};
 	}
@@ -810,11 +1168,13 @@ namespace Allocator {
 		size_t available_blocks = pbh.available_small_blocks (info);
 		if (available_blocks == info.nb_blocks) {
 			// Destroy page block if unused
-			SizeClass::ActivePageBlockList::unlink (pbh);
+			SizeClass::ActivePageBlocks::remove (pbh);
 			destroy_page_block (pbh, spb, space);
 		} else if (available_blocks == 1) {
-			// Was fully used before ; put back in active list
-			active_small_page_blocks[info.sc_id].push_front (pbh);
+			// Was fully used before ; put back in active lists
+			active_small_page_blocks[info.sc_id].insert (pbh, info);
+		} else {
+			active_small_page_blocks[info.sc_id].update (pbh, info);
 		}
 	}
 
@@ -845,14 +1205,40 @@ namespace Allocator {
 
 	inline void ThreadLocalHeap::process_thread_remote_frees (Gas::Space & space) {
 		BlockFreeList unused_blocks = remote_freed_blocks.take_all ();
-		for (auto it = unused_blocks.begin (); it != unused_blocks.end ();) {
-			Ptr p = it->ptr ();
-			SuperpageBlock & spb = it->spb ();
-			it++; // Get next element before destroying the current element
+		while (!unused_blocks.empty ()) {
+			Ptr p = unused_blocks.front ().ptr ();
+			SuperpageBlock & spb = unused_blocks.front ().spb ();
+			unused_blocks.pop_front (); // Before destroying the current element
+
+			if (!spb.in_huge_alloc (p)) {
+				auto & pbh = spb.page_block_header (p);
+				if (pbh.type == MemoryType::small) {
+					// Keep for reuse, at block start (p may be inside the block)
+					auto & info = SizeClass::config[pbh.sb_sizeclass];
+					pbh.clear_small_block_region_metadata (p, info);
+					UnusedBlock * blk = new (pbh.small_block_start (p, info)) UnusedBlock (spb);
+					reusable_small_blocks[info.sc_id].push_front (*blk);
+					if (++nb_reusable_small_blocks[info.sc_id] > info.nb_blocks)
+						flush_reusable_small_blocks (info.sc_id, space);
+					continue;
+				}
+			}
 			thread_local_deallocate (p, spb, space);
 		}
 	}
 
+	inline void ThreadLocalHeap::flush_reusable_small_blocks (size_t sc_id, Gas::Space & space) {
+		// Give all reusable blocks of the sizeclass back to their page blocks
+		auto & reusable = reusable_small_blocks[sc_id];
+		while (!reusable.empty ()) {
+			Ptr p = reusable.front ().ptr ();
+			SuperpageBlock & spb = reusable.front ().spb ();
+			reusable.pop_front ();
+			destroy_small_block (p, spb.page_block_header (p), spb, space);
+		}
+		nb_reusable_small_blocks[sc_id] = 0;
+	}
+
 #ifdef ASSERT_SAFE_ENABLED
 	inline void ThreadLocalHeap::print (const Gas::Space & space) const {
 		printf ("====== ThreadLocalHeap [%p] ======\n", this);
@@ -864,11 +1250,12 @@ namespace Allocator {
 
 		printf ("SizeClass lists:\n");
 		for (size_t i = 0; i < SizeClass::nb_sizeclass; ++i) {
-			printf ("[%zu,bs=%zu]", i, SizeClass::config[i].block_size);
-			for (auto & pbh : active_small_page_blocks[i]) {
+			printf ("[%zu,bs=%zu,reusable=%zu]", i, SizeClass::config[i].block_size,
+			        nb_reusable_small_blocks[i]);
+			active_small_page_blocks[i].for_each ([&space](const PageBlockHeader & pbh) {
 				auto & spb = SuperpageBlock::from_pbh (pbh);
 				printf (" (%zu,%zu)", space.superpage_num (spb.ptr ()), spb.page_block_index (pbh));
-			}
+			});
 			printf ("\n");
 		}
 	}
@@ -1,18 +1,19 @@
 #define ASSERT_LEVEL_SAFE
 
+#include <condition_variable>
+#include <mutex>
+
 #include "allocator.h"
 #include "tests.h"
 
 namespace {
 using namespace Givy;
 
-Allocator::Bootstrap boostrap_allocator;
 thread_local Allocator::ThreadLocalHeap thread_heap;
 Gas::Space space{Ptr (0x4000'0000'0000),     // start
                  100 * VMem::superpage_size, // space_by_node
                  4,                          // nb_node
-                 0,                          // local node
-                 boostrap_allocator};
+                 0};                         // local node
 
 Block allocate (size_t size, size_t align) {
 	return thread_heap.allocate (size, align, space);
@@ -32,6 +33,8 @@ void print (bool print_space = true) {
 #define DETERMINISTIC_SMALL_TEST 1
 #define DETERMINISTIC_MONOTHREAD_TEST 1
 #define MULTITHREAD_SMALL_TEST 1
+#define REGION_METADATA_TEST 1
+#define REUSABLE_HEAP_DEATH_TEST 1
 
 void show (const char * title, bool b = false) {
 	printf ("#################### %s #####################\n", title);
@@ -39,6 +42,90 @@ void show (const char * title, bool b = false) {
 }
 
 int main (void) {
+#if REUSABLE_HEAP_DEATH_TEST
+	{
+		/* Blocks freed by another thread, still in the reusable cache when their heap dies.
+		 * The emptied page block must be destroyed, and the superpages released. Runs first, while
+		 * the main thread heap holds no superpage.
+		 */
+		constexpr size_t nb = 16;
+		std::array<Block, nb> blocks;
+		// Threads wait for each other without spinning, as they may share a single cpu
+		std::mutex mutex;
+		std::condition_variable cond;
+		int step = 0;
+		auto wait_step = [&](int s) {
+			std::unique_lock<std::mutex> lock (mutex);
+			cond.wait (lock, [&] { return step == s; });
+		};
+		auto set_step = [&](int s) {
+			{
+				std::lock_guard<std::mutex> lock (mutex);
+				step = s;
+			}
+			cond.notify_all ();
+		};
+		std::thread owner ([&] {
+			for (auto & b : blocks)
+				b = allocate (64, 1);
+			set_step (1);
+			wait_step (2);
+			deallocate (allocate (64, 1)); // Takes remote frees, serves one of them
+		});
+		std::thread remote ([&] {
+			wait_step (1);
+			for (auto & b : blocks)
+				deallocate (b);
+			set_step (2);
+		});
+		remote.join ();
+		owner.join ();
+		size_t cursor = 0;
+		Ptr all = space.try_reserve_local_superpage_sequence (100, cursor);
+		ASSERT_STD (all != Ptr (nullptr)); // Whole local interval is free
+		space.release_superpage_sequence (all, 100);
+	}
+#endif
+#if REGION_METADATA_TEST
+	{
+		// Slots are per region, start empty, and are cleared when the region is deallocated
+		auto slot = [](Block b) -> std::atomic<void *> & {
+			return Allocator::region_metadata_slot (b.ptr, space);
+		};
+		int tag;
+		auto s1 = allocate (100, 1);
+		auto s2 = allocate (100, 1);
+		auto m = allocate (10 * VMem::page_size, 1);
+		auto h = allocate (3 * VMem::superpage_size, 1);
+		// Lookups do not create the side array of small blocks
+		ASSERT_STD (Allocator::find_region_metadata_slot (s1.ptr, space) == nullptr);
+		for (auto b : {s1, s2, m, h}) {
+			ASSERT_STD (slot (b) == nullptr);
+			slot (b) = &tag;
+			ASSERT_STD (Allocator::find_region_metadata_slot (b.ptr, space) == &slot (b));
+		}
+		ASSERT_STD (&slot (s1) != &slot (s2));
+		ASSERT_STD (&slot ({Ptr (s1.ptr) + 50, 1}) == &slot (s1));
+		ASSERT_STD (&slot ({Ptr (m.ptr) + 5 * VMem::page_size, 1}) == &slot (m));
+		ASSERT_STD (&slot ({Ptr (h.ptr) + 2 * VMem::superpage_size, 1}) == &slot (h));
+		// Region memory covers the allocation, from any pointer inside it
+		for (auto b : {s1, s2, m, h}) {
+			auto region = Allocator::region_memory (Ptr (b.ptr) + (b.size - 1), space);
+			ASSERT_STD (region.ptr == b.ptr);
+			ASSERT_STD (region.size >= b.size);
+		}
+		deallocate (s1);
+		ASSERT_STD (slot (s2) == &tag);
+		s1 = allocate (100, 1);
+		ASSERT_STD (slot (s1) == nullptr);
+		for (auto b : {s1, s2, m, h})
+			deallocate (b);
+		m = allocate (10 * VMem::page_size, 1);
+		ASSERT_STD (slot (m) == nullptr);
+		deallocate (m);
+		printf ("Region metadata slots: ok\n");
+	}
+#endif
 #if DETERMINISTIC_SMALL_TEST
 	{
 		Givy::Allocator::SizeClass::print ();
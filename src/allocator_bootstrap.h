@@ -6,6 +6,7 @@
 #include "block.h"
 #include "math.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 namespace Givy {
@@ -16,8 +17,8 @@ namespace Allocator {
 		 */
 	public:
 		Block allocate (size_t size, size_t align) {
-			ASSERT_SAFE (align >= sizeof (void *));
 			ASSERT_SAFE (Math::is_power_of_2 (align));
+			align = std::max (align, sizeof (void *)); // posix_memalign minimum
 			ASSERT_SAFE (size > 0);
 			void * p = nullptr;
 			int r = posix_memalign (&p, align, size);
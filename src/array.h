@@ -8,7 +8,10 @@
 #include <type_traits>
 
 #include "block.h"
+#include "math.h"
+#include "memory_mapping.h"
 #include "range.h"
+#include "system.h"
 
 namespace Givy {
 
@@ -104,6 +107,46 @@ public:
 	}
 };
 
+/* Dynamic non-resizable array in its own anonymous memory mapping.
+ * Memory is only reserved : the kernel commits zero-filled pages on first touch, so a huge array
+ * costs nothing until used.
+ * Elements are not constructed : T must be valid when zero-filled (integers, atomic integers).
+ */
+template <typename T> class MappedArray {
+	static_assert (std::is_trivially_destructible<T>::value, "T must be trivially destructible");
+
+private:
+	size_t length;
+	T * array;
+
+	size_t mapping_size (void) const { return Math::align_up (length * sizeof (T), VMem::page_size); }
+
+public:
+	explicit MappedArray (size_t size_)
+	    : length (size_),
+	      array (static_cast<T *> (VMem::reserve_anywhere (mapping_size ()))) {
+		ASSERT_SAFE (length > 0);
+	}
+	~MappedArray () { VMem::unmap_checked (array, mapping_size ()); }
+
+	// Prevent copy/move
+	MappedArray (const MappedArray &) = delete;
+	MappedArray & operator=(const MappedArray &) = delete;
+	MappedArray (MappedArray &&) = delete;
+	MappedArray & operator=(MappedArray &&) = delete;
+
+	// Size and access
+	size_t size (void) const { return length; }
+	const T & operator[](size_t i) const {
+		ASSERT_SAFE (i < size ());
+		return array[i];
+	}
+	T & operator[](size_t i) {
+		ASSERT_SAFE (i < size ());
+		return array[i];
+	}
+};
+
 /* Computing index of elements in arrays from pointers
  */
 template <typename T> inline size_t array_index (const T * t, const T * a) {
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <mpi.h>
+#include <thread>
+#include <vector>
+
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Batched read test (DataRequestBatch).
+ * Run with several ranks : each rank fills blocks of its local interval, then several threads
+ * acquire overlapping sets of blocks of all ranks with one batched require_read_only each. Sets
+ * contain local blocks, duplicates, and more than one message worth of blocks per owner.
+ */
+
+namespace {
+constexpr size_t nb_block = 150;
+constexpr size_t block_size = 1000;
+constexpr size_t nb_thread = 4;
+
+unsigned char pattern (int rank, size_t block, size_t i) {
+	return static_cast<unsigned char> (rank * 17 + block * 3 + i);
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+
+	std::vector<void *> locals (nb_block);
+	for (size_t b = 0; b < nb_block; ++b) {
+		auto p = static_cast<unsigned char *> (Givy::allocate (block_size, 1).ptr);
+		for (size_t i = 0; i < block_size; ++i)
+			p[i] = pattern (rank, b, i);
+		locals[b] = p;
+	}
+	auto blocks = all_gather_pointers (locals);
+
+	std::vector<size_t> errors (nb_thread, 0);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nb_thread; ++t)
+		threads.emplace_back ([&](size_t thid) {
+			// Thread t takes the blocks b with b % nb_thread != t, and block 0 twice
+			std::vector<void *> set;
+			std::vector<size_t> indexes;
+			for (size_t index = 0; index < blocks.size (); ++index)
+				if (index % nb_thread != thid || index == 0) {
+					set.push_back (blocks[index]);
+					indexes.push_back (index);
+				}
+			set.push_back (blocks[0]);
+			indexes.push_back (0);
+
+			Givy::require_read_only (set.data (), set.size ());
+			for (size_t n = 0; n < set.size (); ++n) {
+				auto p = static_cast<const unsigned char *> (set[n]);
+				int owner = int(indexes[n] / nb_block);
+				for (size_t i = 0; i < block_size; ++i)
+					if (p[i] != pattern (owner, indexes[n] % nb_block, i))
+						errors[thid]++;
+			}
+		}, t);
+	for (auto & th : threads)
+		th.join ();
+
+	// Everything is valid now : no request
+	Givy::require_read_only (blocks.data (), blocks.size ());
+
+	size_t total = 0;
+	for (auto e : errors)
+		total += e;
+	printf ("[N%d] batched read of %zu blocks: %zu errors\n", rank, blocks.size (), total);
+	ASSERT_STD (total == 0);
+
+	mpi_barrier ();
+	for (auto p : locals)
+		Givy::deallocate (p);
+	return 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef GIVY_BENCHMARK_H
+#define GIVY_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h> // sysconf
+
+/* Small helpers shared by the *.b.cpp benchmark programs.
+ * Timing uses steady_clock ; latency samples are stored raw and sorted for percentiles.
+ */
+
+inline uint64_t now_ns (void) {
+	using namespace std::chrono;
+	return duration_cast<nanoseconds> (steady_clock::now ().time_since_epoch ()).count ();
+}
+
+inline size_t current_rss (void) {
+	// Resident set size in bytes (second field of /proc/self/statm, in pages)
+	size_t total = 0, resident = 0;
+	FILE * f = std::fopen ("/proc/self/statm", "r");
+	if (f != nullptr) {
+		if (std::fscanf (f, "%zu %zu", &total, &resident) != 2)
+			resident = 0;
+		std::fclose (f);
+	}
+	return resident * static_cast<size_t> (sysconf (_SC_PAGESIZE));
+}
+
+struct latency_samples {
+	/* Per-operation latencies in ns.
+	 * Each thread fills its own instance, which are merged at the end of a workload.
+	 */
+	std::vector<uint64_t> samples;
+
+	void reserve (size_t n) { samples.reserve (n); }
+	void add (uint64_t ns) { samples.push_back (ns); }
+	void merge (const latency_samples & other) {
+		samples.insert (samples.end (), other.samples.begin (), other.samples.end ());
+	}
+	uint64_t percentile (double p) {
+		if (samples.empty ())
+			return 0;
+		size_t n = std::min (samples.size () - 1, static_cast<size_t> (p * samples.size ()));
+		std::nth_element (samples.begin (), samples.begin () + n, samples.end ());
+		return samples[n];
+	}
+};
+
+struct bench_result {
+	const char * workload;
+	const char * allocator;
+	size_t nb_ops;
+	uint64_t duration_ns;
+	latency_samples latency;
+	size_t rss_before;
+	size_t rss_after;
+
+	void print (void) {
+		double ops_per_s = duration_ns > 0 ? double(nb_ops) * 1e9 / double(duration_ns) : 0.0;
+		std::printf ("%-28s %-6s %10zu ops %12.0f ops/s p50=%6lluns p99=%7lluns rss=%7zuKiB "
+		             "(%+zdKiB)\n",
+		             workload, allocator, nb_ops, ops_per_s,
+		             static_cast<unsigned long long> (latency.percentile (0.50)),
+		             static_cast<unsigned long long> (latency.percentile (0.99)), rss_after / 1024,
+		             (static_cast<ssize_t> (rss_after) - static_cast<ssize_t> (rss_before)) / 1024);
+	}
+};
+
+inline bool bench_selected (int argc, char * argv[], const char * name) {
+	// No argument runs every workload ; otherwise only the named ones
+	if (argc < 2)
+		return true;
+	for (int i = 1; i < argc; ++i)
+		if (std::strcmp (argv[i], name) == 0)
+			return true;
+	return false;
+}
+
+struct xorshift {
+	// Cheap deterministic PRNG, to keep random number generation out of the measurements
+	uint64_t state;
+	explicit xorshift (uint64_t seed) : state (seed * 0x9E3779B97F4A7C15ull + 1) {}
+	uint64_t operator() (void) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+	size_t in (size_t lo, size_t hi) { return lo + (*this) () % (hi - lo); }
+};
+
+#endif
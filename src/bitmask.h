@@ -2,7 +2,8 @@
 #ifndef GIVY_BITMASK_H
 #define GIVY_BITMASK_H
 
-#include <limits> // numeric_limits
+#include <algorithm> // min
+#include <limits>    // numeric_limits
 #include <cstdint> // uintN_t
 
 #include "reporting.h"
@@ -67,11 +68,11 @@ template <typename IntType> struct BitMask {
 		return b;
 	}
 	static constexpr size_t count_zeros (IntType c) {
-		size_t b = 0;
+		size_t nb_ones = 0;
 		for (; c; c >>= 1)
-			if (c & one () == zeros ())
-				b++;
-		return b;
+			if ((c & one ()) != zeros ())
+				nb_ones++;
+		return bits - nb_ones;
 	}
 	static constexpr size_t count_msb_ones (IntType c) { return count_msb_zeros (~c); }
 
@@ -83,15 +84,19 @@ template <typename IntType> struct BitMask {
 		// require : from_bit + len <= up_to_bit
 		ASSERT_SAFE (from_bit + len <= up_to_bit);
 		// return : offset of first 0s sequence of length 'len' in 'searched' (in [from_bit, up_to_bit[)
-		size_t window_end = from_bit + len;
-		IntType bit_window = window_bound (from_bit, window_end);
-		while (window_end <= up_to_bit) {
-			if ((searched & bit_window) == zeros ())
-				return window_end - len; // found
-			bit_window <<= 1;
-			window_end++;
+		if (len == 0)
+			return from_bit;
+		/* Shift-and reduction : bit i of 'runs' is set if [i, i + k[ are zeros in 'searched'.
+		 * Each step extends k by up to k, so it takes O(log len) steps.
+		 * Zeros shifted in from the msb never create a run ending outside the window.
+		 */
+		IntType runs = ~searched & window_bound (from_bit, up_to_bit);
+		for (size_t k = 1; k < len && runs != zeros ();) {
+			size_t shift = std::min (k, len - k);
+			runs &= runs >> shift;
+			k += shift;
 		}
-		return bits; // not found
+		return count_lsb_zeros (runs); // bits if not found
 	}
 
 	static constexpr size_t find_previous_zero (IntType c, size_t pos) {
@@ -14,6 +14,14 @@ struct givy_block {
 	size_t size;
 };
 
+/* Allocation flags, can be or-ed together.
+ */
+enum givy_alloc_flags {
+	GIVY_ALLOC_DEFAULT = 0x0,
+	GIVY_ALLOC_CACHE_LINE_ISOLATED = 0x1, // No other allocation shares a cache line with the block
+	GIVY_ALLOC_PREFAULT = 0x2,            // Huge allocations are faulted in by the allocating thread
+};
+
 #ifdef __cplusplus
 namespace Givy {
 	using Block = struct givy_block;
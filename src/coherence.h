@@ -2,15 +2,19 @@
 #ifndef GIVY_COHERENCE_H
 #define GIVY_COHERENCE_H
 
+#include <array>
 #include <atomic>
 #include <bitset>
-#include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <utility>
 
 #include "allocator.h"
 #include "block.h"
+#include "coherence_region_table.h"
+#include "coherence_waiter.h"
+#include "concurrency.h"
 #include "intrusive_list.h"
 #include "network.h"
 #include "range.h"
@@ -19,48 +23,73 @@
 namespace Givy {
 namespace Coherence {
 
-	class Waiter;
-	using WaiterList = Intrusive::StackList<Waiter>;
-
-	class Waiter : public WaiterList::Element {
-	private:
-		std::atomic<int> waiting_for{0};
-
-	public:
-		void add_query (void) { waiting_for.fetch_add (1, std::memory_order_relaxed); }
-		void query_done (void) { waiting_for.fetch_sub (1, std::memory_order_relaxed); }
-		void wait (void) {
-			while (waiting_for.load (std::memory_order_acquire) > 0)
-				;
-		}
-	};
-
 	constexpr size_t max_supported_node = 64;
+	using NodeSet = std::bitset<max_supported_node>;
 
 	struct RegionMetadata {
+		/* Single writer / multiple readers state of a region on one node.
+		 * The owner has a valid copy ; it is writable if no other node has a valid copy.
+		 * owner is exact on the owner, and a probable owner elsewhere (requests are forwarded along
+		 * probable owners until they reach the owner).
+		 */
 		Block blk;
-		std::bitset<max_supported_node> valid_set; // For owner only
+		NodeSet valid_set; // For owner only : nodes with a valid copy, owner included
 		BoundUint<max_supported_node> owner;
-		bool valid;
-		WaiterList::Atomic waiters;
-
-		// Invalid region for ptr
+		std::atomic<bool> valid;    // Read without lock
+		std::atomic<bool> writable; // Read without lock
+
+		// Statuses, under manager lock
+		bool waiting_data{false};  // DataRequest in flight
+		bool waiting_owner{false}; // OwnerRequest in flight, or owner invalidating other copies
+		bool stale_data{false};    // Invalidated while waiting data : the answer is not kept valid
+		bool data_replaced{false}; // Data received by an ownership transfer while waiting data
+		size_t pending_acks{0};
+		NodeSet deferred_data_requests; // Received while invalidating, or during write sections
+		NodeSet deferred_owner_requests;
+		std::atomic<bool> requests_deferred{false}; // Any deferred request ; read without lock
+
+		// Local writers from request_region_writable (waiting included) to release_region_writable
+		std::atomic<size_t> write_sections{0};
+
+		QueryList::Atomic waiters;       // Waiting for valid
+		QueryList::Atomic owner_waiters; // Waiting for writable
+
+		// Deallocation, under manager lock
+		bool freed_here{false};
+		NodeSet users;    // Allocation node only : nodes that requested the region
+		NodeSet freed_by; // Allocation node only : users that deallocated the region
+		size_t pending_destroy_acks{0};
+
+		// Initially the region is only valid (and writable) on its allocation node, which owns it
 		RegionMetadata (void * ptr, const Gas::Space & space)
-		    : blk{ptr, 0}, owner (space.node_of_allocation (ptr)), valid (false) {}
+		    : blk{ptr, 0},
+		      owner (space.node_of_allocation (ptr)),
+		      valid (space.in_local_interval (ptr)),
+		      writable (space.in_local_interval (ptr)) {
+			if (space.in_local_interval (ptr)) {
+				blk = Allocator::region_memory (ptr, space);
+				valid_set.set (owner);
+			}
+		}
 	};
 
 	/* Coherence messages.
+	 * Region contents follow DataAnswer, and OwnerTransfer if it has data, in a data message.
+	 * Requests keep the requesting node in from when they are forwarded.
 	 */
 	enum class MessageType : uint8_t {
 		// Protocol
 		DataRequest,
+		DataRequestBatch,
 		DataAnswer,
 		OwnerRequest,
 		OwnerTransfer,
 		InvalidationRequest,
 		InvalidationAck,
-		// Others
+		// Deallocation
 		Deallocate,
+		Destroy,
+		DestroyAck,
 		// Control
 		NodeFinished,
 	};
@@ -70,25 +99,53 @@ namespace Coherence {
 		void * ptr;
 		size_t from;
 	};
+	constexpr size_t max_data_request_batch = 64;
+	struct DataRequestBatchMsg {
+		// DataRequests of one node to the same probable owner ; only the first nb are sent
+		MessageType type{MessageType::DataRequestBatch};
+		size_t nb{0};
+		void * ptrs[max_data_request_batch];
+
+		size_t size (void) const {
+			return sizeof (DataRequestBatchMsg) - (max_data_request_batch - nb) * sizeof (void *);
+		}
+	};
 	struct DataAnswerMsg {
 		MessageType type;
 		void * ptr;
+		Block blk; // Whole region
 	};
 	struct OwnerRequestMsg {
 		MessageType type;
+		void * ptr;
+		size_t from;
 	};
 	struct OwnerTransferMsg {
 		MessageType type;
+		void * ptr;
+		Block blk;
+		unsigned long long valid_set; // NodeSet, without the previous owner
+		bool with_data;               // No data if the new owner has a valid copy
 	};
 	struct InvalidationRequestMsg {
 		MessageType type;
+		void * ptr;
+		size_t from; // New owner
 	};
 	struct InvalidationAckMsg {
 		MessageType type;
+		void * ptr;
 	};
+	constexpr size_t max_deallocate_batch = 64;
 	struct DeallocateMsg {
+		// Batch of regions for Deallocate, Destroy and DestroyAck ; only the first nb are sent
 		MessageType type;
-		Block blk;
+		size_t nb{0};
+		void * ptrs[max_deallocate_batch];
+
+		size_t size (void) const {
+			return sizeof (DeallocateMsg) - (max_deallocate_batch - nb) * sizeof (void *);
+		}
 	};
 
 	struct NodeFinishedMsg {
@@ -100,34 +157,57 @@ namespace Coherence {
 	private:
 		std::mutex mutex;
 
-		const Gas::Space & space;
+		Gas::Space & space;
 		Network & network;
 
-		std::thread thread;
-
 		/* metadata rationale:
 		 * - if regions is created locally and has never been shared: no metadata
 		 * - metadata is created at first need (DataReq / OwnerReq received)
-		 * - metadata is destroyed only at Free
+		 * - metadata is destroyed only at Free, on all nodes (deallocation protocol)
+		 * Metadata objects are stored in the table. Metadata of local regions is also reachable from
+		 * the allocator headers of the region (Allocator::region_metadata_slot), without lookup.
+		 * Lookups of valid regions are lock-free ; protocol changes are made under mutex.
+		 * Regions are identified by their start pointer on all nodes.
+		 */
+		RegionTable<RegionMetadata> regions;
+
+		/* Deallocation messages are batched by destination and type (under mutex).
+		 * A batch is sent when full, or by the next progress call.
 		 */
-		std::map<void *, RegionMetadata> regions;
+		static constexpr size_t nb_deallocate_msg_type = 3;
+		std::array<std::array<DeallocateMsg, max_supported_node>, nb_deallocate_msg_type>
+		    deallocate_batches;
+		std::atomic<bool> deallocate_batches_pending{false};
+
+		// Heap for the deallocations of the progress engine (serialized by progress_mutex)
+		Allocator::ThreadLocalHeap progress_heap;
 
 		/* Termination management : all nodes track the number of alive node.
 		 * On finish, a node decrements its alive counter, and broadcasts to everyone to let them
 		 * decrement theirs.
 		 * On zero, exit.
 		 */
-		size_t nb_node_still_running;
+		std::atomic<size_t> nb_node_still_running;
+
+		// Only one thread handles messages at a time, so data messages match their answers in order
+		std::mutex progress_mutex;
+
+		// Progress thread, started last
+		std::thread thread;
 
 		// ----------
 	public:
-		Manager (const Gas::Space & space, Network & network)
+		Manager (Gas::Space & space, Network & network)
 		    : space (space),
 		      network (network),
-		      thread ([=] { event_loop (); }),
-		      nb_node_still_running (network.nb_node ()) {}
+		      nb_node_still_running (network.nb_node ()),
+		      thread ([=] { event_loop (); }) {}
 
 		~Manager () {
+			{
+				std::lock_guard<std::mutex> lock (mutex);
+				flush_deallocate_batches ();
+			}
 			// Send Finished messages
 			{
 				for (auto target : range (network.nb_node ()))
@@ -136,9 +216,9 @@ namespace Coherence {
 						network.send_to (target, &msg, sizeof (msg));
 					}
 				// No self message, so track ourselves
-				std::lock_guard<std::mutex> lock (mutex);
-				nb_node_still_running--;
-				DEBUG_TEXT ("[N%zu] finished, count=%zu\n", network.node_id (), nb_node_still_running);
+				size_t count = --nb_node_still_running;
+				(void) count; // Only traced
+				DEBUG_TEXT ("[N%zu] finished, count=%zu\n", network.node_id (), count);
 			}
 
 			// Wait for system exit
@@ -147,75 +227,634 @@ namespace Coherence {
 
 		void request_region_valid (void * ptr) {
 			Waiter waiter;
+			Query query (waiter);
+			if (start_region_valid (ptr, query))
+				waiter.wait ();
+		}
+
+		/* Start getting a valid copy of the region, without waiting.
+		 * Returns false if the copy is already valid ; otherwise query is linked to the region, and
+		 * completed when the copy is valid. query and its waiter must stay in place until then.
+		 */
+		bool start_region_valid (void * ptr, Query & query) {
+			if (valid_without_lock (ptr))
+				return false;
+
+			std::lock_guard<std::mutex> lock (mutex);
+			auto metadata = metadata_to_validate (ptr);
+			if (metadata == nullptr)
+				return false;
+
+			add_valid_query (*metadata, query);
+			if (!metadata->waiting_data && !metadata->waiting_owner) {
+				// Send query if none in flight ; an ownership transfer also brings the data
+				metadata->waiting_data = true;
+				DataRequestMsg msg{MessageType::DataRequest, ptr, network.node_id ()};
+				network.send_to (metadata->owner, &msg, sizeof (msg));
+			}
+			return true;
+		}
+
+		/* Valid copies of several regions, with one request message by probable owner.
+		 * Requests are grouped in DataRequestBatch messages (a new one every max_data_request_batch
+		 * regions), and all the queries complete a single waiter.
+		 */
+		void request_regions_valid (void * const * ptrs, size_t nb) {
+			std::vector<void *> missing;
+			for (size_t i = 0; i < nb; ++i)
+				if (!valid_without_lock (ptrs[i]))
+					missing.push_back (ptrs[i]);
+			if (missing.empty ())
+				return;
+
+			Waiter waiter;
+			std::vector<Query> queries (missing.size ());
+			std::vector<DataRequestBatchMsg> batches (network.nb_node ());
+			{
+				std::lock_guard<std::mutex> lock (mutex);
+				for (size_t i = 0; i < missing.size (); ++i) {
+					auto metadata = metadata_to_validate (missing[i]);
+					if (metadata == nullptr)
+						continue;
+
+					queries[i].waiter = &waiter;
+					add_valid_query (*metadata, queries[i]);
+					if (!metadata->waiting_data && !metadata->waiting_owner) {
+						metadata->waiting_data = true;
+						auto & batch = batches[metadata->owner];
+						batch.ptrs[batch.nb++] = missing[i];
+						if (batch.nb == max_data_request_batch)
+							send_data_request_batch (batch, metadata->owner);
+					}
+				}
+				for (auto to : range (network.nb_node ()))
+					if (batches[to].nb > 0)
+						send_data_request_batch (batches[to], to);
+			}
+			waiter.wait ();
+		}
+
+		void request_region_writable (void * ptr) {
+			/* Ownership of the region, without any other valid copy, and start of a write section.
+			 * Requests of other nodes are deferred until the end of the section
+			 * (release_region_writable) : writes of the section cannot be lost, even if other nodes
+			 * were already waiting for the region.
+			 * A local region that was never shared has no section : the first request of another node
+			 * must be ordered after the writes by the application.
+			 * Regions of pinned nodes (accessed in place by their co-located nodes) stay owned by
+			 * their allocation node : other nodes cannot write them, which is rejected here, before
+			 * any request.
+			 */
+			if (!space.in_local_interval (ptr) && space.is_pinned (space.node_of_allocation (ptr)))
+				FAILURE ("require_read_write: region %p of pinned node %zu (GIVY_SHARED_MAPPING)", ptr,
+				         space.node_of_allocation (ptr));
+
+			// Fast path without lock : writable, or local and never shared
+			if (auto metadata = find_metadata (ptr)) {
+				if (enter_write_section (*metadata, ptr))
+					return;
+			} else if (space.in_local_interval (ptr)) {
+				return;
+			}
+
+			Waiter waiter;
+			Query query (waiter);
 			{
 				std::lock_guard<std::mutex> lock (mutex);
 
 				auto metadata = get_metadata (ptr);
-				if (metadata) {
-					if (metadata->valid)
-						return; // Already valid
-				} else {
+				if (metadata == nullptr) {
 					if (space.in_local_interval (ptr))
-						return; // Valid and never share
-
-					// No header and not local : construct in place
-					metadata = create_metadata_invalid (ptr);
+						return;
+					metadata = create_metadata (ptr);
 				}
+				// Writable only changes under lock ; a waiting writer holds its section while waiting
+				metadata->write_sections.fetch_add (1);
+				if (metadata->writable)
+					return;
 
 				waiter.add_query ();
-				if (metadata->waiters.push_front (waiter)) {
-					// Send query if no entry was in the table
-					DataRequestMsg msg{MessageType::DataRequest, ptr, network.node_id ()};
-					network.send_to (space.node_of_allocation (ptr), &msg, sizeof (msg));
+				metadata->owner_waiters.push_front (query);
+				if (!metadata->waiting_owner) {
+					metadata->waiting_owner = true;
+					if (metadata->owner == network.node_id ()) {
+						invalidate_other_copies (*metadata, ptr); // Owner with readers
+					} else {
+						OwnerRequestMsg msg{MessageType::OwnerRequest, ptr, network.node_id ()};
+						network.send_to (metadata->owner, &msg, sizeof (msg));
+					}
 				}
 			}
 			waiter.wait ();
 		}
+		void release_region_writable (void * ptr) {
+			// End of a write section ; deferred requests are served when the last section ends
+			if (auto metadata = find_metadata (ptr))
+				leave_write_section (*metadata, ptr);
+		}
+
+		/* Progress engine : receive and handle all pending messages.
+		 * Returns false if there was no message, or if another thread is already progressing.
+		 * The manager mutex is not held while polling ; handlers take it if they need it.
+		 * The manager thread calls it with backoff ; it can also be called by an external progress
+		 * source (network callback, idle application thread).
+		 */
+		bool progress (void) {
+			std::unique_lock<std::mutex> lock (progress_mutex, std::try_to_lock);
+			if (!lock.owns_lock ())
+				return false;
+			bool handled = false;
+			size_t from;
+			while (auto data = network.try_recv (from)) {
+				handle_message (Ptr (data.get ()), from);
+				handled = true;
+			}
+			if (deallocate_batches_pending.exchange (false, std::memory_order_acquire)) {
+				std::lock_guard<std::mutex> lock (mutex);
+				flush_deallocate_batches ();
+			}
+			return handled;
+		}
+
+		void deallocate (void * ptr, Allocator::ThreadLocalHeap & tlh) {
+			/* Non blocking distributed free.
+			 * A local region that was never shared is deallocated immediately. Otherwise every node
+			 * that used the region deallocates it too ; see the deallocation protocol below.
+			 * Local metadata is looked up without lock in the allocator headers : it is not created for
+			 * a region being deallocated (no node may request it), and not destroyed before this node
+			 * deallocates it. Remote regions are looked up under lock, as a miss of the lock-free
+			 * region table would skip the Deallocate, and leak the region on its allocation node.
+			 */
+			if (space.in_local_interval (ptr)) {
+				auto metadata = local_metadata (ptr);
+				if (metadata == nullptr) {
+					tlh.deallocate (ptr, space);
+				} else {
+					std::lock_guard<std::mutex> lock (mutex);
+					ASSERT_SAFE (!metadata->freed_here);
+					metadata->freed_here = true;
+					try_destroy (*metadata, ptr);
+				}
+			} else {
+				std::lock_guard<std::mutex> lock (mutex);
+				auto metadata = get_metadata (ptr);
+				if (metadata == nullptr)
+					return; // Never used here
+				ASSERT_SAFE (!metadata->freed_here);
+				metadata->freed_here = true;
+				queue_deallocate_msg (MessageType::Deallocate, space.node_of_allocation (ptr), ptr);
+			}
+		}
 
 	private:
-		void on_data_request (const DataRequestMsg & msg) { std::lock_guard<std::mutex> lock (mutex); }
+		/* Protocol.
+		 * Read: a DataRequest is forwarded to the owner, which answers with the whole region (sent
+		 * from the region memory) and adds the requester to valid_set. The requester receives the
+		 * data at the region address, and wakes its waiters.
+		 * Write: an OwnerRequest is forwarded to the owner, and sets the probable owner of the
+		 * forwarding nodes to the requester. The owner gives up its copy, and sends an OwnerTransfer
+		 * with valid_set (and the data if the requester has no valid copy). The new owner invalidates
+		 * all other copies, and becomes writable when all acks are received.
+		 * A node waiting for ownership (or invalidating) defers requests until it is writable, as in
+		 * the dynamic distributed manager of Li & Hudak : probable owners then always lead to the
+		 * owner, without cycles. The owner also defers requests during local write sections.
+		 * Messages are sent under manager lock, so that messages to a node are in protocol order.
+		 */
+		void on_data_request (const DataRequestMsg & msg) {
+			std::lock_guard<std::mutex> lock (mutex);
+			handle_data_request (msg);
+		}
+		void on_data_request_batch (const DataRequestBatchMsg & msg, size_t from) {
+			// Separate requests ; forwarded ones are sent as single DataRequests
+			std::lock_guard<std::mutex> lock (mutex);
+			for (size_t i = 0; i < msg.nb; ++i)
+				handle_data_request (DataRequestMsg{MessageType::DataRequest, msg.ptrs[i], from});
+		}
+		void handle_data_request (const DataRequestMsg & msg) {
+			auto & metadata = get_or_create_metadata_for_request (msg.ptr, msg.from);
+			if (!metadata.waiting_owner && metadata.owner != network.node_id ()) {
+				network.send_to (metadata.owner, &msg, sizeof (msg));
+			} else {
+				metadata.deferred_data_requests.set (msg.from);
+				defer_request (metadata, msg.ptr);
+			}
+		}
+		void on_data_answer (const DataAnswerMsg & msg, size_t from) {
+			/* An invalidation of a new owner may overtake the answer : the data is received, as of
+			 * the request, and waiters read it, but the copy is not valid.
+			 * If an ownership transfer brought newer data before the answer, the answer is discarded
+			 * (waiters were completed by the transfer). data_replaced is only set by this thread.
+			 */
+			auto metadata = get_metadata_locked (msg.ptr);
+			if (metadata == nullptr || metadata->data_replaced) {
+				std::unique_ptr<char[]> discarded (new char[msg.blk.size]);
+				network.recv_data_from (from, discarded.get (), msg.blk.size);
+			} else {
+				recv_region (msg.blk, from);
+			}
+			if (metadata == nullptr)
+				return; // Stale answer of a destroyed region
+			std::lock_guard<std::mutex> lock (mutex);
+			ASSERT_STD (metadata->waiting_data);
+			metadata->waiting_data = false;
+			if (metadata->data_replaced) {
+				metadata->data_replaced = false;
+				metadata->stale_data = false;
+				return;
+			}
+			metadata->blk = msg.blk;
+			if (metadata->stale_data) {
+				metadata->stale_data = false; // Owner is the invalidating node
+			} else {
+				metadata->owner = from;
+				metadata->valid.store (true, std::memory_order_release);
+			}
+			Waiter::query_done_all (metadata->waiters.take_all ());
+		}
+
+		void on_owner_request (const OwnerRequestMsg & msg) {
+			std::lock_guard<std::mutex> lock (mutex);
+			auto & metadata = get_or_create_metadata_for_request (msg.ptr, msg.from);
+			ASSERT_STD (msg.from != network.node_id ());
+			if (!metadata.waiting_owner && metadata.owner != network.node_id ()) {
+				network.send_to (metadata.owner, &msg, sizeof (msg));
+				metadata.owner = msg.from;
+			} else {
+				metadata.deferred_owner_requests.set (msg.from);
+				defer_request (metadata, msg.ptr);
+			}
+		}
+		void on_owner_transfer (const OwnerTransferMsg & msg, size_t from) {
+			if (msg.with_data)
+				recv_region (msg.blk, from);
+			std::lock_guard<std::mutex> lock (mutex);
+			auto metadata = get_metadata (msg.ptr);
+			ASSERT_STD (metadata != nullptr);
+			ASSERT_STD (metadata->waiting_owner);
+			if (metadata->waiting_data)
+				metadata->data_replaced = true; // The answer in flight is older
+			metadata->owner = network.node_id ();
+			metadata->blk = msg.blk;
+			metadata->valid_set = NodeSet (msg.valid_set);
+			metadata->valid_set.set (network.node_id ());
+			metadata->valid.store (true, std::memory_order_release);
+			Waiter::query_done_all (metadata->waiters.take_all ());
+			invalidate_other_copies (*metadata, msg.ptr);
+		}
+
+		void on_invalidation_request (const InvalidationRequestMsg & msg) {
+			std::lock_guard<std::mutex> lock (mutex);
+			auto metadata = get_metadata (msg.ptr);
+			ASSERT_STD (metadata != nullptr);
+			ASSERT_STD (metadata->owner != network.node_id ());
+			metadata->valid.store (false, std::memory_order_relaxed);
+			metadata->owner = msg.from;
+			if (metadata->waiting_data)
+				metadata->stale_data = true; // Data answer may still be in flight
+			InvalidationAckMsg ack{MessageType::InvalidationAck, msg.ptr};
+			network.send_to (msg.from, &ack, sizeof (ack));
+		}
+		void on_invalidation_ack (const InvalidationAckMsg & msg) {
+			std::lock_guard<std::mutex> lock (mutex);
+			auto metadata = get_metadata (msg.ptr);
+			ASSERT_STD (metadata != nullptr);
+			ASSERT_STD (metadata->pending_acks > 0);
+			if (--metadata->pending_acks == 0)
+				ownership_acquired (*metadata, msg.ptr);
+		}
+
+		/* Deallocation protocol.
+		 * The allocation node records users : all nodes that requested the region, as the first
+		 * request of a node always goes to the allocation node. Users send Deallocate to the
+		 * allocation node, but keep their metadata to serve requests of nodes still using the
+		 * region. When the allocation node and all users have deallocated it, the allocation node
+		 * sends Destroy : users erase their metadata (and discard their copy) and answer DestroyAck.
+		 * The region memory is reclaimed after all acks, so its address cannot be reused while a
+		 * node still has metadata for it.
+		 * A node must not request a region after all its users have deallocated it.
+		 */
+		void on_deallocate (const DeallocateMsg & msg, size_t from) {
+			std::lock_guard<std::mutex> lock (mutex);
+			for (size_t i = 0; i < msg.nb; ++i) {
+				auto metadata = get_metadata (msg.ptrs[i]);
+				ASSERT_STD (metadata != nullptr);
+				ASSERT_SAFE (metadata->users.test (from));
+				ASSERT_SAFE (!metadata->freed_by.test (from));
+				metadata->freed_by.set (from);
+				try_destroy (*metadata, msg.ptrs[i]);
+			}
+		}
+		void on_destroy (const DeallocateMsg & msg, size_t from) {
+			std::lock_guard<std::mutex> lock (mutex);
+			for (size_t i = 0; i < msg.nb; ++i) {
+				void * ptr = msg.ptrs[i];
+				auto metadata = get_metadata (ptr);
+				ASSERT_STD (metadata != nullptr);
+				discard_copy (metadata->blk);
+				regions.erase (ptr);
+				queue_deallocate_msg (MessageType::DestroyAck, from, ptr);
+			}
+		}
+		void on_destroy_ack (const DeallocateMsg & msg) {
+			std::lock_guard<std::mutex> lock (mutex);
+			for (size_t i = 0; i < msg.nb; ++i) {
+				void * ptr = msg.ptrs[i];
+				auto metadata = get_metadata (ptr);
+				ASSERT_STD (metadata != nullptr);
+				ASSERT_STD (metadata->pending_destroy_acks > 0);
+				if (--metadata->pending_destroy_acks == 0) {
+					local_metadata_slot (ptr).store (nullptr, std::memory_order_relaxed);
+					regions.erase (ptr);
+					progress_heap.deallocate (ptr, space);
+				}
+			}
+		}
 
 		// Under lock !
-		RegionMetadata * get_metadata (void * ptr) {
-			auto it = regions.find (ptr);
-			if (it == regions.end ())
-				return nullptr;
+		void try_destroy (RegionMetadata & metadata, void * ptr) {
+			// Allocation node ; users is not empty, as metadata is only created for requests
+			ASSERT_SAFE (metadata.users.any ());
+			if (!metadata.freed_here || (metadata.users & ~metadata.freed_by).any ())
+				return;
+			for (auto node : range (network.nb_node ()))
+				if (metadata.users.test (node)) {
+					queue_deallocate_msg (MessageType::Destroy, node, ptr);
+					metadata.pending_destroy_acks++;
+				}
+		}
+		void discard_copy (Block blk) {
+			// Give back the whole pages of a copy of a remote region
+			Ptr first = Ptr (blk.ptr).align_up (VMem::page_size);
+			Ptr last = (Ptr (blk.ptr) + blk.size).align (VMem::page_size);
+			if (first < last)
+				VMem::discard_checked (first, last - first);
+		}
+		void queue_deallocate_msg (MessageType type, size_t to, void * ptr) {
+			auto & batch = deallocate_batches[size_t (type) - size_t (MessageType::Deallocate)][to];
+			batch.type = type;
+			batch.ptrs[batch.nb++] = ptr;
+			if (batch.nb == max_deallocate_batch)
+				send_deallocate_batch (batch, to);
 			else
-				return &(it->second);
+				deallocate_batches_pending.store (true, std::memory_order_release);
+		}
+		void flush_deallocate_batches (void) {
+			for (auto & batches : deallocate_batches)
+				for (auto node : range (network.nb_node ()))
+					if (batches[node].nb > 0)
+						send_deallocate_batch (batches[node], node);
 		}
-		RegionMetadata * create_metadata_invalid (void * ptr) {
-			return &(regions
-			             .emplace (std::piecewise_construct, std::forward_as_tuple (ptr),
-			                       std::forward_as_tuple (ptr, space))
-			             .first->second);
+		void send_deallocate_batch (DeallocateMsg & batch, size_t to) {
+			network.send_to (to, &batch, batch.size ());
+			batch.nb = 0;
+		}
+		void send_data_request_batch (DataRequestBatchMsg & batch, size_t to) {
+			network.send_to (to, &batch, batch.size ());
+			batch.nb = 0;
 		}
 
-		void event_loop (void) {
-			while (true) {
-				std::lock_guard<std::mutex> lock (mutex);
-				if (nb_node_still_running == 0) {
-					// EXIT
-					return;
+		void send_data (RegionMetadata & metadata, void * ptr, size_t to) {
+			metadata.writable.store (false, std::memory_order_relaxed);
+			metadata.valid_set.set (to);
+			DataAnswerMsg answer{MessageType::DataAnswer, ptr, metadata.blk};
+			network.send_to (to, &answer, sizeof (answer));
+			network.send_data_to (to, metadata.blk.ptr, metadata.blk.size);
+		}
+		void transfer_ownership (RegionMetadata & metadata, void * ptr, size_t to) {
+			// Requests for regions of pinned nodes are rejected by the requester
+			ASSERT_SAFE (!(space.in_local_interval (ptr) && space.is_pinned (network.node_id ())));
+			auto self = network.node_id ();
+			metadata.valid_set.reset (self);
+			bool with_data = !metadata.valid_set.test (to);
+			OwnerTransferMsg transfer{MessageType::OwnerTransfer, ptr, metadata.blk,
+			                          metadata.valid_set.to_ullong (), with_data};
+			network.send_to (to, &transfer, sizeof (transfer));
+			if (with_data)
+				network.send_data_to (to, metadata.blk.ptr, metadata.blk.size);
+			metadata.valid.store (false, std::memory_order_relaxed);
+			metadata.writable.store (false, std::memory_order_relaxed);
+			metadata.valid_set.reset ();
+			metadata.owner = to;
+		}
+		void invalidate_other_copies (RegionMetadata & metadata, void * ptr) {
+			// Owner, with waiting_owner set
+			auto self = network.node_id ();
+			for (auto node : range (network.nb_node ()))
+				if (node != self && metadata.valid_set.test (node)) {
+					InvalidationRequestMsg msg{MessageType::InvalidationRequest, ptr, self};
+					network.send_to (node, &msg, sizeof (msg));
+					metadata.pending_acks++;
 				}
+			metadata.valid_set.reset ();
+			metadata.valid_set.set (self);
+			if (metadata.pending_acks == 0)
+				ownership_acquired (metadata, ptr);
+		}
+		void ownership_acquired (RegionMetadata & metadata, void * ptr) {
+			// Wake local writers ; deferred requests wait for the end of their write sections
+			metadata.waiting_owner = false;
+			metadata.writable.store (true, std::memory_order_release);
+			Waiter::query_done_all (metadata.owner_waiters.take_all ());
+			serve_deferred_requests (metadata, ptr);
+		}
 
-				size_t from;
-				auto data = network.try_recv (from);
-				if (!data)
-					continue;
-				auto buf = Ptr (data.get ());
-
-				switch (buf.as_ref<MessageType> ()) {
-				case MessageType::DataRequest: {
-					on_data_request (buf.as_ref<DataRequestMsg> ());
-				} break;
-				case MessageType::NodeFinished: {
-					nb_node_still_running--;
-					DEBUG_TEXT ("[N%zu] Recv NodeFinished(%zu), count=%zu\n", network.node_id (), from,
-					            nb_node_still_running);
-				} break;
-				default:
-					break;
+		/* Write sections.
+		 * Writers enter a section without lock, then check writable ; the owner clears writable
+		 * before checking sections (close_write_sections) : either the writer sees the region not
+		 * writable (and leaves), or the owner sees the section and keeps deferring.
+		 * In the same way, a deferred request is flagged before checking sections, and the last
+		 * writer leaves its section before checking the flag : one of them serves the requests.
+		 */
+		bool enter_write_section (RegionMetadata & metadata, void * ptr) {
+			// Without lock ; false if not writable
+			metadata.write_sections.fetch_add (1);
+			if (metadata.writable.load ())
+				return true;
+			leave_write_section (metadata, ptr);
+			return false;
+		}
+		void leave_write_section (RegionMetadata & metadata, void * ptr) {
+			// Without lock
+			auto sections = metadata.write_sections.load ();
+			do {
+				if (sections == 0)
+					return; // Section entered before the region was shared
+			} while (!metadata.write_sections.compare_exchange_weak (sections, sections - 1));
+			if (sections == 1 && metadata.requests_deferred.load ()) {
+				std::lock_guard<std::mutex> lock (mutex);
+				serve_deferred_requests (metadata, ptr);
+			}
+		}
+		// Under lock !
+		bool close_write_sections (RegionMetadata & metadata) {
+			// Owner ; true if no write section, with writable cleared until requests are served
+			bool writable = metadata.writable.exchange (false);
+			if (metadata.write_sections.load () == 0)
+				return true;
+			metadata.writable.store (writable);
+			return false;
+		}
+		void defer_request (RegionMetadata & metadata, void * ptr) {
+			// Request of the owner or of a node waiting for ownership, served now if possible
+			metadata.requests_deferred.store (true);
+			serve_deferred_requests (metadata, ptr);
+		}
+		void serve_deferred_requests (RegionMetadata & metadata, void * ptr) {
+			/* Owner, when not waiting for ownership and out of write sections : readers first, then
+			 * the first writer, to which other writers are forwarded.
+			 */
+			if (metadata.waiting_owner || !metadata.requests_deferred.load () ||
+			    !close_write_sections (metadata))
+				return;
+			metadata.requests_deferred.store (false);
+
+			auto self = network.node_id ();
+			for (auto node : range (network.nb_node ()))
+				if (metadata.deferred_data_requests.test (node))
+					send_data (metadata, ptr, node);
+			metadata.deferred_data_requests.reset ();
+			for (auto node : range (network.nb_node ()))
+				if (metadata.deferred_owner_requests.test (node)) {
+					if (metadata.owner == self) {
+						transfer_ownership (metadata, ptr, node);
+					} else {
+						OwnerRequestMsg msg{MessageType::OwnerRequest, ptr, node};
+						network.send_to (metadata.owner, &msg, sizeof (msg));
+					}
 				}
+			metadata.deferred_owner_requests.reset ();
+		}
+
+		void recv_region (Block blk, size_t from) {
+			// Data message following a protocol message ; no lock, as the region is not valid here
+			if (!space.in_local_interval (blk.ptr))
+				space.map_remote (range_from_offset (Ptr (blk.ptr), blk.size));
+			network.recv_data_from (from, blk.ptr, blk.size);
+		}
+
+		// Lock-free, may miss metadata created concurrently
+		bool valid_without_lock (void * ptr) {
+			/* Colocated (same physical memory as the allocation node, which keeps the ownership),
+			 * valid, or local and never shared
+			 */
+			if (space.in_colocated_interval (ptr))
+				return true;
+			if (auto metadata = find_metadata (ptr))
+				return metadata->valid.load (std::memory_order_acquire);
+			return space.in_local_interval (ptr);
+		}
+		RegionMetadata * metadata_to_validate (void * ptr) {
+			// Under manager lock ; nullptr if the copy is already valid
+			auto metadata = get_metadata (ptr);
+			if (metadata)
+				return metadata->valid ? nullptr : metadata;
+			if (space.in_local_interval (ptr))
+				return nullptr; // Valid and never shared
+			return create_metadata (ptr); // No header and not local : construct in place
+		}
+		void add_valid_query (RegionMetadata & metadata, Query & query) {
+			query.waiter->add_query ();
+			metadata.waiters.push_front (query);
+		}
+
+		RegionMetadata * find_metadata (void * ptr) {
+			if (space.in_local_interval (ptr))
+				return local_metadata (ptr);
+			else
+				return regions.find (ptr);
+		}
+
+		RegionMetadata * get_metadata_locked (void * ptr) {
+			std::lock_guard<std::mutex> lock (mutex);
+			return get_metadata (ptr);
+		}
+
+		// Under lock !
+		RegionMetadata * get_metadata (void * ptr) {
+			if (space.in_local_interval (ptr))
+				return local_metadata (ptr);
+			else
+				return regions.find_locked (ptr);
+		}
+		RegionMetadata * create_metadata (void * ptr) {
+			auto & metadata = regions.find_or_emplace (ptr, ptr, space);
+			if (space.in_local_interval (ptr))
+				local_metadata_slot (ptr).store (&metadata, std::memory_order_release);
+			return &metadata;
+		}
+		RegionMetadata & get_or_create_metadata_for_request (void * ptr, size_t from) {
+			// Requests reach nodes that know the region, or its allocation node
+			auto metadata = get_metadata (ptr);
+			if (metadata == nullptr) {
+				ASSERT_STD (space.in_local_interval (ptr));
+				metadata = create_metadata (ptr);
+			}
+			if (space.in_local_interval (ptr))
+				metadata->users.set (from);
+			return *metadata;
+		}
+		RegionMetadata * local_metadata (void * ptr) {
+			// Allocator headers of the region, without allocating ; acquire pairs with create_metadata
+			auto * slot = Allocator::find_region_metadata_slot (ptr, space);
+			if (slot == nullptr)
+				return nullptr;
+			return static_cast<RegionMetadata *> (slot->load (std::memory_order_acquire));
+		}
+		std::atomic<void *> & local_metadata_slot (void * ptr) {
+			// Creates the slot storage if needed ; for create_metadata
+			return Allocator::region_metadata_slot (ptr, space);
+		}
+
+		void event_loop (void) {
+			// Exits when all nodes are finished
+			Backoff backoff;
+			while (nb_node_still_running.load (std::memory_order_acquire) > 0) {
+				if (progress ())
+					backoff.reset ();
+				else
+					backoff.pause ();
+			}
+		}
+
+		void handle_message (Ptr buf, size_t from) {
+			switch (buf.as_ref<MessageType> ()) {
+			case MessageType::DataRequest: {
+				on_data_request (buf.as_ref<DataRequestMsg> ());
+			} break;
+			case MessageType::DataRequestBatch: {
+				on_data_request_batch (buf.as_ref<DataRequestBatchMsg> (), from);
+			} break;
+			case MessageType::DataAnswer: {
+				on_data_answer (buf.as_ref<DataAnswerMsg> (), from);
+			} break;
+			case MessageType::OwnerRequest: {
+				on_owner_request (buf.as_ref<OwnerRequestMsg> ());
+			} break;
+			case MessageType::OwnerTransfer: {
+				on_owner_transfer (buf.as_ref<OwnerTransferMsg> (), from);
+			} break;
+			case MessageType::InvalidationRequest: {
+				on_invalidation_request (buf.as_ref<InvalidationRequestMsg> ());
+			} break;
+			case MessageType::InvalidationAck: {
+				on_invalidation_ack (buf.as_ref<InvalidationAckMsg> ());
+			} break;
+			case MessageType::Deallocate: {
+				on_deallocate (buf.as_ref<DeallocateMsg> (), from);
+			} break;
+			case MessageType::Destroy: {
+				on_destroy (buf.as_ref<DeallocateMsg> (), from);
+			} break;
+			case MessageType::DestroyAck: {
+				on_destroy_ack (buf.as_ref<DeallocateMsg> ());
+			} break;
+			case MessageType::NodeFinished: {
+				size_t count = --nb_node_still_running;
+				(void) count; // Only traced
+				DEBUG_TEXT ("[N%zu] Recv NodeFinished(%zu), count=%zu\n", network.node_id (), from, count);
+			} break;
+			default:
+				break;
 			}
 		}
 	};
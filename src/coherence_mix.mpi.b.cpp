@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <mpi.h>
+#include <vector>
+
+#include "benchmark.h"
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Read-write coherence throughput, for read-mostly and write-heavy mixes.
+ * Regions are allocated round-robin on all ranks ; every rank then accesses random regions with
+ * require_read_only or require_read_write, without synchronization between ranks. Each access reads
+ * or increments the first word of the region ; at the end, counters must hold all the increments.
+ * Usage: mpirun -np <n> bench_coherence_mix [workload...] ; no argument runs all workloads.
+ */
+
+namespace {
+constexpr size_t nb_region = 64;
+constexpr size_t region_size = 4096;
+constexpr size_t nb_access = 4000;
+
+void mix (const char * name, int rank, int nb_rank, unsigned write_percent) {
+	std::vector<void *> regions (nb_region);
+	std::vector<void *> locals;
+	for (size_t r = 0; r < nb_region; ++r) {
+		void * p = nullptr;
+		if (r % nb_rank == size_t (rank)) {
+			p = Givy::allocate (region_size, 1).ptr;
+			*static_cast<size_t *> (p) = 0;
+			locals.push_back (p);
+		}
+		broadcast_pointers (&p, 1, int(r % nb_rank));
+		regions[r] = p;
+	}
+	mpi_barrier ();
+
+	xorshift rng (rank);
+	latency_samples lat;
+	lat.reserve (nb_access);
+	size_t sum = 0;
+	std::vector<size_t> increments (nb_region, 0);
+	auto start = now_ns ();
+	for (size_t i = 0; i < nb_access; ++i) {
+		auto r = rng.in (0, nb_region);
+		auto p = regions[r];
+		auto t0 = now_ns ();
+		if (rng.in (0, 100) < write_percent) {
+			Givy::require_read_write (p);
+			(*static_cast<volatile size_t *> (p))++;
+			Givy::release_read_write (p);
+			increments[r]++;
+		} else {
+			Givy::require_read_only (p);
+			sum += *static_cast<volatile size_t *> (p);
+		}
+		lat.add (now_ns () - t0);
+	}
+	auto duration = now_ns () - start;
+	(void) sum;
+
+	char workload[40];
+	std::snprintf (workload, sizeof (workload), "%s/N%d", name, rank);
+	bench_result r{workload, "givy", nb_access, duration, std::move (lat), 0, 0};
+	r.print ();
+
+	// Lost increments
+	all_reduce_sum (increments);
+	for (size_t r = 0; r < nb_region; ++r) {
+		Givy::require_read_only (regions[r]);
+		ASSERT_OPT (*static_cast<const size_t *> (regions[r]) == increments[r]);
+	}
+
+	mpi_barrier ();
+	for (auto p : locals)
+		Givy::deallocate (p);
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+	if (bench_selected (argc, argv, "read_mostly"))
+		mix ("read_mostly", rank, nb_rank, 5);
+	if (bench_selected (argc, argv, "write_heavy"))
+		mix ("write_heavy", rank, nb_rank, 50);
+	return 0;
+}
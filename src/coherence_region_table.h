@@ -0,0 +1,192 @@
+#pragma once
+#ifndef GIVY_COHERENCE_REGION_TABLE_H
+#define GIVY_COHERENCE_REGION_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+#include "allocator_bootstrap.h"
+#include "reporting.h"
+#include "system.h"
+#include "types.h"
+
+namespace Givy {
+namespace Coherence {
+
+	template <typename T, size_t shard_nb = 64, size_t bucket_by_shard = 256> class RegionTable {
+		/* Concurrent hash table of region metadata, keyed by region base pointer.
+		 *
+		 * The table is split in shards ; each shard has a fixed array of buckets (chained nodes) and a
+		 * mutex for modifications. find is lock-free : it is exact for entries that are not
+		 * inserted or erased concurrently, but may miss such entries. Authoritative lookups are
+		 * done with find_locked or find_or_emplace.
+		 *
+		 * Nodes are pool-allocated in slabs from the Bootstrap allocator. Node memory is only given
+		 * back at table destruction, so a lock-free reader never touches freed memory ; it checks the
+		 * key of every node. Fields of T read by lock-free readers must be atomics.
+		 * Erased nodes are kept in a per bucket free list, and only reused in their bucket : a reader
+		 * standing on a reused node is sent back to the head of its own bucket, never to another
+		 * chain. A bucket keeps the nodes of its peak size.
+		 *
+		 * shard_nb and bucket_by_shard are only changed by tests (small tables, long chains).
+		 */
+	private:
+		static constexpr size_t node_by_slab = 64;
+
+		struct Node {
+			std::atomic<Node *> next{nullptr};
+			std::atomic<void *> key{nullptr};
+			Constructible<T> value;
+			Node * next_free{nullptr}; // Separate link : erased nodes keep next for readers
+		};
+		struct Slab {
+			Slab * next;
+			std::array<Node, node_by_slab> nodes;
+		};
+
+		struct alignas (VMem::cache_line_size) Shard {
+			std::mutex mutex;
+			std::array<std::atomic<Node *>, bucket_by_shard> buckets;
+			std::array<Node *, bucket_by_shard> free_nodes; // Erased from the bucket
+			Node * new_nodes{nullptr};                      // Never linked
+			Slab * slabs{nullptr};
+			Shard () {
+				for (auto & b : buckets)
+					b.store (nullptr, std::memory_order_relaxed);
+				free_nodes.fill (nullptr);
+			}
+		};
+
+		std::array<Shard, shard_nb> shards;
+		Allocator::Bootstrap bootstrap;
+
+	public:
+		RegionTable () = default;
+		~RegionTable () {
+			for (auto & shard : shards) {
+				for (auto & b : shard.buckets)
+					for (Node * n = b.load (std::memory_order_relaxed); n != nullptr;
+					     n = n->next.load (std::memory_order_relaxed))
+						n->value.destruct ();
+				while (shard.slabs != nullptr) {
+					Slab * slab = shard.slabs;
+					shard.slabs = slab->next;
+					slab->~Slab ();
+					bootstrap.deallocate ({slab, sizeof (Slab)});
+				}
+			}
+		}
+
+		// Prevent copy/move
+		RegionTable (const RegionTable &) = delete;
+		RegionTable & operator=(const RegionTable &) = delete;
+
+		T * find (void * key) {
+			/* Lock-free. Acquires pair with the release stores of find_or_emplace : the value is
+			 * constructed before the node is published, and before its key is set (for readers that
+			 * reach a reused node from a stale link).
+			 */
+			auto & bucket = bucket_of (shard_of (key), key);
+			for (Node * n = bucket.load (std::memory_order_acquire); n != nullptr;
+			     n = n->next.load (std::memory_order_acquire))
+				if (n->key.load (std::memory_order_acquire) == key)
+					return &n->value.object ();
+			return nullptr;
+		}
+
+		T * find_locked (void * key) {
+			auto & shard = shard_of (key);
+			std::lock_guard<std::mutex> lock (shard.mutex);
+			Node * n = find_in_bucket (bucket_of (shard, key), key);
+			return n != nullptr ? &n->value.object () : nullptr;
+		}
+
+		template <typename... Args> T & find_or_emplace (void * key, Args &&... args) {
+			// Nodes are fully built before being published at the head of the bucket
+			ASSERT_SAFE (key != nullptr);
+			auto & shard = shard_of (key);
+			std::lock_guard<std::mutex> lock (shard.mutex);
+			auto & bucket = bucket_of (shard, key);
+			Node * n = find_in_bucket (bucket, key);
+			if (n == nullptr) {
+				n = new_node (shard, bucket_index (key));
+				n->value.construct (std::forward<Args> (args)...);
+				n->key.store (key, std::memory_order_release);
+				n->next.store (bucket.load (std::memory_order_relaxed), std::memory_order_relaxed);
+				bucket.store (n, std::memory_order_release);
+			}
+			return n->value.object ();
+		}
+
+		bool erase (void * key) {
+			/* Unlinked nodes keep their next link, so a concurrent reader standing on it continues in
+			 * the bucket. The key is cleared before the value is destroyed.
+			 */
+			auto & shard = shard_of (key);
+			std::lock_guard<std::mutex> lock (shard.mutex);
+			auto * link = &bucket_of (shard, key);
+			for (Node * n = link->load (std::memory_order_relaxed); n != nullptr;
+			     n = link->load (std::memory_order_relaxed)) {
+				if (n->key.load (std::memory_order_relaxed) == key) {
+					link->store (n->next.load (std::memory_order_relaxed), std::memory_order_release);
+					n->key.store (nullptr, std::memory_order_relaxed);
+					n->value.destruct ();
+					free_node (shard.free_nodes[bucket_index (key)], n);
+					return true;
+				}
+				link = &n->next;
+			}
+			return false;
+		}
+
+	private:
+		static size_t hash (void * key) {
+			// Region bases are at least 16B aligned ; Fibonacci hashing of the remaining bits
+			auto h = (reinterpret_cast<uintptr_t> (key) >> 4) * uint64_t (0x9E3779B97F4A7C15);
+			return static_cast<size_t> (h >> 32);
+		}
+		Shard & shard_of (void * key) { return shards[hash (key) % shard_nb]; }
+		static size_t bucket_index (void * key) { return (hash (key) / shard_nb) % bucket_by_shard; }
+		std::atomic<Node *> & bucket_of (Shard & shard, void * key) {
+			return shard.buckets[bucket_index (key)];
+		}
+
+		// Under shard lock
+		static Node * find_in_bucket (std::atomic<Node *> & bucket, void * key) {
+			for (Node * n = bucket.load (std::memory_order_relaxed); n != nullptr;
+			     n = n->next.load (std::memory_order_relaxed))
+				if (n->key.load (std::memory_order_relaxed) == key)
+					return n;
+			return nullptr;
+		}
+		Node * new_node (Shard & shard, size_t bucket) {
+			// A node erased from the bucket first, then a node never linked
+			if (shard.free_nodes[bucket] != nullptr)
+				return pop_node (shard.free_nodes[bucket]);
+			if (shard.new_nodes == nullptr) {
+				auto blk = bootstrap.allocate (sizeof (Slab), alignof (Slab));
+				Slab * slab = new (blk.ptr) Slab;
+				slab->next = shard.slabs;
+				shard.slabs = slab;
+				for (auto & n : slab->nodes)
+					free_node (shard.new_nodes, &n);
+			}
+			return pop_node (shard.new_nodes);
+		}
+		static Node * pop_node (Node *& list) {
+			Node * n = list;
+			list = n->next_free;
+			return n;
+		}
+		static void free_node (Node *& list, Node * n) {
+			n->next_free = list;
+			list = n;
+		}
+	};
+}
+}
+
+#endif
@@ -0,0 +1,128 @@
+#define ASSERT_LEVEL_SAFE
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "coherence_region_table.h"
+
+using namespace Givy;
+
+namespace {
+struct Entry {
+	std::atomic<size_t> value;
+	Entry (size_t v) : value (v) {}
+};
+
+void * key_of (size_t i) {
+	return reinterpret_cast<void *> ((i + 1) * 64);
+}
+}
+
+int main (void) {
+	{
+		// Sequential
+		Coherence::RegionTable<Entry> table;
+		constexpr size_t nb = 10000;
+		for (size_t i = 0; i < nb; ++i)
+			table.find_or_emplace (key_of (i), i);
+		for (size_t i = 0; i < nb; ++i) {
+			ASSERT_STD (table.find (key_of (i)) != nullptr);
+			ASSERT_STD (table.find (key_of (i))->value == i);
+			ASSERT_STD (&table.find_or_emplace (key_of (i), 0) == table.find (key_of (i)));
+		}
+		for (size_t i = 0; i < nb; i += 2)
+			ASSERT_STD (table.erase (key_of (i)));
+		ASSERT_STD (!table.erase (key_of (0)));
+		for (size_t i = 0; i < nb; ++i)
+			ASSERT_STD ((table.find_locked (key_of (i)) != nullptr) == (i % 2 == 1));
+		// Reuse of erased nodes
+		for (size_t i = 0; i < nb; i += 2)
+			table.find_or_emplace (key_of (i), i);
+		for (size_t i = 0; i < nb; ++i)
+			ASSERT_STD (table.find (key_of (i))->value == i);
+		printf ("Sequential: ok\n");
+	}
+	{
+		/* Lock-free readers of stable entries, while writers insert and erase other entries.
+		 * Stable entries are never missed, and are never seen with a wrong value.
+		 */
+		Coherence::RegionTable<Entry> table;
+		constexpr size_t nb_stable = 1000;
+		constexpr size_t nb_writer = 2;
+		constexpr size_t nb_reader = 2;
+		constexpr size_t nb_round = 200;
+		constexpr size_t churn = 1000;
+		for (size_t i = 0; i < nb_stable; ++i)
+			table.find_or_emplace (key_of (i), i);
+
+		std::atomic<size_t> writers_running{nb_writer};
+		std::atomic<size_t> errors{0};
+		std::vector<std::thread> threads;
+		for (size_t w = 0; w < nb_writer; ++w)
+			threads.emplace_back ([&](size_t thid) {
+				size_t base = nb_stable + thid * churn;
+				for (size_t round = 0; round < nb_round; ++round) {
+					for (size_t i = base; i < base + churn; ++i)
+						table.find_or_emplace (key_of (i), i);
+					for (size_t i = base; i < base + churn; ++i)
+						table.erase (key_of (i));
+				}
+				writers_running--;
+			}, w);
+		for (size_t r = 0; r < nb_reader; ++r)
+			threads.emplace_back ([&] {
+				while (writers_running > 0)
+					for (size_t i = 0; i < nb_stable; ++i) {
+						auto e = table.find (key_of (i));
+						if (e == nullptr || e->value != i)
+							errors++;
+					}
+			});
+		for (auto & th : threads)
+			th.join ();
+		printf ("Concurrent: %zu errors\n", errors.load ());
+		ASSERT_STD (errors == 0);
+	}
+	{
+		/* Node reuse under lock-free readers : a table with 2 buckets, where churn entries are
+		 * spread along the chains of stable entries. Each erased node is reused right away by the
+		 * next insertion ; readers standing on it must not be sent to the other chain.
+		 */
+		Coherence::RegionTable<Entry, 1, 2> table;
+		constexpr size_t nb_stable = 1000;
+		constexpr size_t nb_round = 100;
+		for (size_t i = 0; i < nb_stable; ++i) {
+			table.find_or_emplace (key_of (i), i);
+			table.find_or_emplace (key_of (nb_stable + i), 0);
+		}
+
+		std::atomic<bool> writer_running{true};
+		std::atomic<size_t> errors{0};
+		std::vector<std::thread> threads;
+		threads.emplace_back ([&] {
+			// Churn keys alternate between [nb_stable, 2 nb_stable) and [2 nb_stable, 3 nb_stable)
+			for (size_t round = 0; round < nb_round; ++round)
+				for (size_t c = 0; c < nb_stable; ++c) {
+					table.erase (key_of ((1 + round % 2) * nb_stable + c));
+					table.find_or_emplace (key_of ((1 + (round + 1) % 2) * nb_stable + c), 0);
+				}
+			writer_running = false;
+		});
+		for (size_t r = 0; r < 2; ++r)
+			threads.emplace_back ([&] {
+				while (writer_running)
+					for (size_t i = 0; i < nb_stable; ++i) {
+						auto e = table.find (key_of (i));
+						if (e == nullptr || e->value != i)
+							errors++;
+					}
+			});
+		for (auto & th : threads)
+			th.join ();
+		printf ("Node reuse: %zu errors\n", errors.load ());
+		ASSERT_STD (errors == 0);
+	}
+	return 0;
+}
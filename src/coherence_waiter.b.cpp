@@ -0,0 +1,112 @@
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include "coherence_waiter.h"
+#include "benchmark.h"
+
+/* Coherence::Waiter under oversubscription.
+ * Many waiter threads each wait for one query, completed by a single completer thread after a
+ * simulated network delay. Measures wake latency (completion to waiter resumption) and the process
+ * CPU time. Compares a spin-only waiter with the spin-then-futex Waiter.
+ * Usage: bench_coherence_waiter [workload...] ; no argument runs all workloads.
+ */
+
+namespace {
+using namespace Givy;
+
+class SpinWaiter {
+	// Spin-only baseline : waits on the query count without pause or yield
+private:
+	std::atomic<uint32_t> waiting_for{0};
+
+public:
+	void add_query (void) { waiting_for.fetch_add (1, std::memory_order_relaxed); }
+	void query_done (void) { waiting_for.fetch_sub (1, std::memory_order_release); }
+	void wait (void) {
+		while (waiting_for.load (std::memory_order_acquire) > 0)
+			;
+	}
+};
+
+uint64_t process_cpu_ns (void) {
+	timespec ts;
+	clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return uint64_t (ts.tv_sec) * 1000000000 + uint64_t (ts.tv_nsec);
+}
+
+template <typename W> void oversubscribed (const char * waiter_name, size_t nb_waiter) {
+	constexpr size_t nb_round = 100;
+	constexpr uint64_t delay_ns = 20000; // Simulated round trip
+
+	struct alignas (64) Slot {
+		std::atomic<W *> waiter{nullptr};
+		std::atomic<uint64_t> completed_at{0};
+	};
+	std::vector<Slot> slots (nb_waiter);
+	std::vector<latency_samples> lats (nb_waiter);
+
+	char name[40];
+	std::snprintf (name, sizeof (name), "oversubscribed/%zu", nb_waiter);
+	bench_result r{name, waiter_name, nb_waiter * nb_round, 0, {}, current_rss (), 0};
+	auto cpu_start = process_cpu_ns ();
+	auto start = now_ns ();
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nb_waiter; ++t)
+		threads.emplace_back ([&](size_t thid) {
+			auto & slot = slots[thid];
+			lats[thid].reserve (nb_round);
+			for (size_t round = 0; round < nb_round; ++round) {
+				W waiter;
+				waiter.add_query ();
+				slot.waiter.store (&waiter, std::memory_order_release);
+				waiter.wait ();
+				lats[thid].add (now_ns () - slot.completed_at.load (std::memory_order_relaxed));
+			}
+		}, t);
+
+	// Completer : completes each published query delay_ns after it was first seen
+	std::vector<uint64_t> seen_at (nb_waiter, 0);
+	size_t done = 0;
+	while (done < nb_waiter * nb_round) {
+		for (size_t t = 0; t < nb_waiter; ++t) {
+			W * w = slots[t].waiter.load (std::memory_order_acquire);
+			if (w == nullptr)
+				continue;
+			auto now = now_ns ();
+			if (seen_at[t] == 0) {
+				seen_at[t] = now;
+			} else if (now - seen_at[t] >= delay_ns) {
+				seen_at[t] = 0;
+				slots[t].waiter.store (nullptr, std::memory_order_relaxed);
+				slots[t].completed_at.store (now_ns (), std::memory_order_relaxed);
+				w->query_done ();
+				done++;
+			}
+		}
+	}
+	for (auto & th : threads)
+		th.join ();
+	r.duration_ns = now_ns () - start;
+	auto cpu_ns = process_cpu_ns () - cpu_start;
+	for (auto & l : lats)
+		r.latency.merge (l);
+	r.rss_after = current_rss ();
+	r.print ();
+	std::printf ("%-28s %-6s cpu=%.1fms (%.2f cores)\n", name, waiter_name, double(cpu_ns) / 1e6,
+	             double(cpu_ns) / double(r.duration_ns));
+}
+}
+
+int main (int argc, char * argv[]) {
+	size_t nb_cpu = std::thread::hardware_concurrency ();
+	if (nb_cpu == 0)
+		nb_cpu = 1;
+	if (bench_selected (argc, argv, "oversubscribed")) {
+		oversubscribed<SpinWaiter> ("spin", 4 * nb_cpu);
+		oversubscribed<Coherence::Waiter> ("futex", 4 * nb_cpu);
+	}
+	return 0;
+}
@@ -0,0 +1,140 @@
+#pragma once
+#ifndef GIVY_COHERENCE_WAITER_H
+#define GIVY_COHERENCE_WAITER_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "concurrency.h"
+#include "intrusive_list.h"
+
+namespace Givy {
+namespace Coherence {
+
+	class Query;
+	using QueryList = Intrusive::StackList<Query>;
+
+	class Waiter {
+		/* A thread waiting for the completion of its coherence queries.
+		 *
+		 * wait () spins briefly, then parks the thread on a futex until query_done () completes the
+		 * last query. Without futex support, it falls back to a spin/yield/sleep Backoff.
+		 *
+		 * state holds the number of pending queries, and the parked bit if the waiting thread is (or
+		 * is about to be) asleep. Completion decrements the count and wakes the waiter only if the
+		 * parked bit is set : no syscall if the waiter is still spinning.
+		 * The Waiter may be destroyed as soon as its last query is done, so query_done () only
+		 * touches state once ; the wake syscall on a dead address is harmless (spurious wakeups are
+		 * rechecked by waiters).
+		 * A waiter can wait for several regions at once, with one Query linked in each region.
+		 */
+	private:
+		static constexpr uint32_t parked_bit = uint32_t (1) << 31;
+		static constexpr uint32_t count_mask = parked_bit - 1;
+		static constexpr unsigned spin_rounds = 1000;
+
+		std::atomic<uint32_t> state{0};
+
+	public:
+		void add_query (void) { state.fetch_add (1, std::memory_order_relaxed); }
+
+		void query_done (void) {
+			uint32_t old = state.fetch_sub (1, std::memory_order_acq_rel);
+			ASSERT_SAFE ((old & count_mask) > 0);
+			if (old == (parked_bit | 1))
+				wake (&state);
+		}
+
+		// Non blocking : true if all queries are done
+		bool done (void) const { return (state.load (std::memory_order_acquire) & count_mask) == 0; }
+
+		void wait (void) {
+			for (unsigned i = 0; i < spin_rounds; ++i)
+				if (done ())
+					return;
+#ifdef __linux__
+			while (true) {
+				uint32_t s = state.load (std::memory_order_acquire);
+				if ((s & count_mask) == 0) {
+					state.store (0, std::memory_order_relaxed); // No query left : clear parked bit
+					return;
+				}
+				if (!(s & parked_bit) &&
+				    !state.compare_exchange_weak (s, s | parked_bit, std::memory_order_acquire,
+				                                  std::memory_order_acquire))
+					continue;
+				futex (&state, FUTEX_WAIT_PRIVATE, s | parked_bit);
+			}
+#else
+			Backoff backoff;
+			while (!done ())
+				backoff.pause ();
+#endif
+		}
+
+		/* Complete each query of the list.
+		 * Counts are all decremented first, then parked waiters are woken : waiters that are still
+		 * spinning return without any syscall.
+		 */
+		static void query_done_all (QueryList && list);
+
+	private:
+		static void wake (std::atomic<uint32_t> * word) {
+#ifdef __linux__
+			futex (word, FUTEX_WAKE_PRIVATE, INT_MAX);
+#else
+			(void) word;
+#endif
+		}
+
+#ifdef __linux__
+		static void futex (std::atomic<uint32_t> * word, int op, uint32_t value) {
+			static_assert (sizeof (std::atomic<uint32_t>) == sizeof (uint32_t), "futex word size");
+			syscall (SYS_futex, reinterpret_cast<uint32_t *> (word), op, value, nullptr, nullptr, 0);
+		}
+#endif
+	};
+
+	class Query : public QueryList::Element {
+		/* One pending query of a Waiter, linked in the waiting list of a region.
+		 * Owned by the waiting thread, and must stay in place until completed.
+		 */
+	public:
+		Waiter * waiter{nullptr};
+
+		Query () = default;
+		explicit Query (Waiter & w) : waiter (&w) {}
+	};
+
+	inline void Waiter::query_done_all (QueryList && list) {
+		constexpr size_t batch = 64;
+		std::atomic<uint32_t> * to_wake[batch];
+		size_t nb_to_wake = 0;
+		while (!list.empty ()) {
+			Waiter & w = *list.front ().waiter;
+			list.pop_front (); // Before completion, as the query and w may then be destroyed
+			uint32_t old = w.state.fetch_sub (1, std::memory_order_acq_rel);
+			ASSERT_SAFE ((old & Waiter::count_mask) > 0);
+			if (old == (Waiter::parked_bit | 1)) {
+				if (nb_to_wake == batch) {
+					for (size_t i = 0; i < nb_to_wake; ++i)
+						wake (to_wake[i]);
+					nb_to_wake = 0;
+				}
+				to_wake[nb_to_wake++] = &w.state;
+			}
+		}
+		for (size_t i = 0; i < nb_to_wake; ++i)
+			wake (to_wake[i]);
+	}
+}
+}
+
+#endif
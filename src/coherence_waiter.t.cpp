@@ -0,0 +1,86 @@
+#define ASSERT_LEVEL_SAFE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "coherence_waiter.h"
+
+using namespace Givy;
+
+/* Waiters completed by another thread, either before waiting (spin path), or long after (parked
+ * path). Each waiter checks that all the work published before its completions is visible.
+ */
+
+namespace {
+constexpr size_t nb_waiter = 16;
+constexpr size_t nb_round = 200;
+constexpr int nb_query = 3;
+
+struct Slot {
+	std::atomic<Coherence::Waiter *> waiter{nullptr};
+	size_t data{0};
+};
+
+void run (bool batched) {
+	std::vector<Slot> slots (nb_waiter);
+	std::atomic<size_t> errors{0};
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nb_waiter; ++t)
+		threads.emplace_back ([&](size_t thid) {
+			for (size_t round = 0; round < nb_round; ++round) {
+				Coherence::Waiter waiter;
+				for (int q = 0; q < nb_query; ++q)
+					waiter.add_query ();
+				slots[thid].waiter.store (&waiter, std::memory_order_release);
+				waiter.wait ();
+				if (slots[thid].data != round * nb_query + nb_query)
+					errors++;
+				slots[thid].data = (round + 1) * nb_query;
+			}
+		}, t);
+
+	// Completer : one query of every published waiter per pass, sleeping sometimes to park waiters
+	size_t done = 0;
+	std::vector<int> completed (nb_waiter, 0);
+	std::vector<Coherence::Query> queries (nb_waiter);
+	while (done < nb_waiter * nb_round * nb_query) {
+		Coherence::QueryList list;
+		for (size_t t = 0; t < nb_waiter; ++t) {
+			Coherence::Waiter * w = slots[t].waiter.load (std::memory_order_acquire);
+			if (w == nullptr)
+				continue;
+			slots[t].data++;
+			done++;
+			if (++completed[t] == nb_query) {
+				// Last query : the waiter may reuse the slot right after completion
+				completed[t] = 0;
+				slots[t].waiter.store (nullptr, std::memory_order_relaxed);
+			}
+			if (batched) {
+				queries[t].waiter = w;
+				list.push_front (queries[t]);
+			} else {
+				w->query_done ();
+			}
+		}
+		if (batched)
+			Coherence::Waiter::query_done_all (std::move (list));
+		if (done % 7 == 0)
+			std::this_thread::sleep_for (std::chrono::microseconds (200));
+	}
+	for (auto & th : threads)
+		th.join ();
+	printf ("Waiters (%s): %zu waiters x %zu rounds, %zu errors\n", batched ? "batched" : "single",
+	        nb_waiter, nb_round, errors.load ());
+	ASSERT_STD (errors == 0);
+}
+}
+
+int main (void) {
+	run (false);
+	run (true);
+	return 0;
+}
@@ -3,6 +3,8 @@
 #define GIVY_CONCURRENCY_H
 
 #include <atomic>
+#include <chrono>
+#include <thread>
 
 /* TODO ?
  * #include <thread>
@@ -31,6 +33,38 @@ public:
 		locked.store (false, std::memory_order_release);
 	}
 };
+
+class Backoff {
+	/* Adaptive backoff for polling loops.
+	 * pause () spins for the first rounds, then yields, then sleeps with an exponentially growing
+	 * duration, up to max_sleep_us. reset () when the polled condition made progress.
+	 */
+private:
+	static constexpr unsigned spin_rounds = 64;
+	static constexpr unsigned yield_rounds = 64;
+	static constexpr unsigned min_sleep_us = 1;
+	static constexpr unsigned max_sleep_us = 1000;
+
+	unsigned round{0};
+	unsigned sleep_us{min_sleep_us};
+
+public:
+	void reset (void) {
+		round = 0;
+		sleep_us = min_sleep_us;
+	}
+	void pause (void) {
+		if (round < spin_rounds) {
+			round++;
+		} else if (round < spin_rounds + yield_rounds) {
+			round++;
+			std::this_thread::yield ();
+		} else {
+			std::this_thread::sleep_for (std::chrono::microseconds (sleep_us));
+			sleep_us = sleep_us * 2 < max_sleep_us ? sleep_us * 2 : max_sleep_us;
+		}
+	}
+};
 }
 
 #endif
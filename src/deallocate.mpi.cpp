@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <mpi.h>
+#include <vector>
+
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Distributed deallocation test.
+ * Run with several ranks, with a small GAS interval by node. At each round, every rank allocates a
+ * huge region and a small counter, that all other ranks read (and write for the counter), then all
+ * ranks deallocate them without waiting for each other. Regions that are never reclaimed fill the
+ * local interval after a few rounds.
+ */
+
+namespace {
+constexpr size_t nb_round = 100;
+constexpr size_t huge_size = 4 << 20; // 3 superpages with header ; 100 rounds need 600MiB
+constexpr size_t space_by_node = 128 << 20;
+}
+
+int main (int argc, char * argv[]) {
+	Givy::GasConfig config;
+	config.space_by_node = space_by_node;
+	Givy::init (argc, argv, config);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+
+	size_t errors = 0;
+	for (size_t round = 0; round < nb_round; ++round) {
+		auto huge = static_cast<size_t *> (Givy::allocate (huge_size, 1).ptr);
+		auto counter = static_cast<size_t *> (Givy::allocate (sizeof (size_t), 1).ptr);
+		huge[0] = huge[huge_size / sizeof (size_t) - 1] = round * nb_rank + rank;
+		*counter = 0;
+		auto huges = all_gather_pointers (huge);
+		auto counters = all_gather_pointers (counter);
+
+		// Increments of the counters in turn : ownership moves to the last writer
+		for (int turn = 0; turn < nb_rank; ++turn) {
+			if (turn == rank)
+				for (auto p : counters) {
+					Givy::require_read_write (p);
+					(*static_cast<size_t *> (p))++;
+					Givy::release_read_write (p);
+				}
+			mpi_barrier ();
+		}
+		for (int r = 0; r < nb_rank; ++r) {
+			Givy::require_read_only (huges[r]);
+			auto h = static_cast<const size_t *> (huges[r]);
+			if (h[0] != round * nb_rank + r || h[huge_size / sizeof (size_t) - 1] != h[0])
+				errors++;
+			Givy::require_read_only (counters[r]);
+			if (*static_cast<const size_t *> (counters[r]) != size_t (nb_rank))
+				errors++;
+		}
+		mpi_barrier (); // All reads done before the last deallocations
+
+		// No synchronization : remote deallocations complete in the background
+		for (int r = 0; r < nb_rank; ++r) {
+			Givy::deallocate (huges[(rank + r) % nb_rank]);
+			Givy::deallocate (counters[(rank + r) % nb_rank]);
+		}
+	}
+	printf ("[N%d] %zu rounds: %zu errors\n", rank, nb_round, errors);
+	ASSERT_STD (errors == 0);
+	return 0;
+}
@@ -3,6 +3,7 @@
 #define GIVY_GAS_SPACE_H
 
 #include <cstdio>
+#include <vector>
 
 #include "pointer.h"
 #include "range.h"
@@ -10,13 +11,14 @@
 #include "system.h"
 #include "memory_mapping.h"
 #include "superpage_tracker.h"
-#include "allocator_bootstrap.h"
 
 namespace Givy {
 namespace Gas {
-	class Space {
+	template <typename Mapping> class BasicSpace {
 		/* Gas organisation class.
 		 * Manages the virtual address space of the GAS.
+		 * Mapping is the virtual mapping policy of the local interval (VMem::EagerMapping,
+		 * VMem::LazyMapping or VMem::SharedMapping).
 		 */
 	private:
 		const size_t nb_node;
@@ -27,11 +29,18 @@ namespace Gas {
 		const Range<size_t> local_interval_sp;
 		const Range<Ptr> local_interval;
 
-		SuperpageTracker<Allocator::Bootstrap> superpage_tracker;
+		SuperpageTracker superpage_tracker;
+		Mapping mapping;
+
+		// Nodes whose local interval is mapped here (shared segment of a co-located node)
+		std::vector<bool> colocated_nodes;
+		std::vector<bool> pinned_nodes; // Nodes whose local interval is mapped by a co-located node
+
+		// Superpages of remote intervals mapped here to receive copies of remote regions
+		std::vector<bool> remote_mapped;
 
 	public:
-		Space (Ptr gas_start_, size_t space_by_node_, size_t nb_node_, size_t local_node_,
-		       Allocator::Bootstrap & alloc)
+		BasicSpace (Ptr gas_start_, size_t space_by_node_, size_t nb_node_, size_t local_node_)
 		    : // node info
 		      nb_node (nb_node_),
 		      local_node (local_node_),
@@ -43,11 +52,29 @@ namespace Gas {
 		      local_interval_sp (range_from_offset (local_node, 1) * superpage_by_node),
 		      local_interval (gas_interval.first () + VMem::superpage_size * local_interval_sp),
 		      // spt
-		      superpage_tracker (superpage_by_node * nb_node, alloc) {
+		      superpage_tracker (superpage_by_node * nb_node),
+		      colocated_nodes (nb_node, false),
+		      pinned_nodes (nb_node, false),
+		      remote_mapped (superpage_by_node * nb_node, false) {
 			ASSERT_STD (nb_node > 0);
 			ASSERT_STD (superpage_by_node > 0);
 			ASSERT_STD (local_node < nb_node);
+			ASSERT_STD (gas_interval.last ().p <= VMem::user_space_end);
+			mapping.setup (local_interval.first (), local_interval.size ());
 		}
+		~BasicSpace () {
+			for (auto num : range (remote_mapped.size ()))
+				if (remote_mapped[num])
+					VMem::unmap_checked (superpage (num), VMem::superpage_size);
+			for (auto node : range (nb_node))
+				if (colocated_nodes[node])
+					VMem::unmap_checked (node_interval (node).first (), node_interval (node).size ());
+			mapping.cleanup (local_interval.first (), local_interval.size ());
+		}
+
+		// Prevent copy/move
+		BasicSpace (const BasicSpace &) = delete;
+		BasicSpace & operator=(const BasicSpace &) = delete;
 
 		// Position info
 		bool in_gas (Ptr p) const { return gas_interval.contains (p); }
@@ -60,29 +87,116 @@ namespace Gas {
 			ASSERT_SAFE (in_gas (p));
 			return (p - gas_interval.first ()) / (superpage_by_node * VMem::superpage_size);
 		}
+		Range<Ptr> node_interval (size_t node) const {
+			ASSERT_SAFE (node < nb_node);
+			return gas_interval.first () +
+			       VMem::superpage_size * (range_from_offset (node, 1) * superpage_by_node);
+		}
+
+		/* Co-located nodes.
+		 * The local interval of a node on the same host can be mapped at its GAS address, from the
+		 * file descriptor of its shared segment (VMem::SharedMapping). Its memory is then accessed
+		 * directly, without coherence messages. Attaching fails if the area is not free.
+		 */
+		const Mapping & local_mapping (void) const { return mapping; }
+		bool attach_colocated_node (size_t node, int segment_fd) {
+			ASSERT_STD (node < nb_node);
+			ASSERT_STD (node != local_node);
+			ASSERT_STD (!colocated_nodes[node]);
+			auto interval = node_interval (node);
+			if (VMem::map_shared_file (interval.first (), interval.size (), segment_fd) != 0)
+				return false;
+			colocated_nodes[node] = true;
+			return true;
+		}
+		bool in_colocated_interval (Ptr p) const {
+			return in_gas (p) && colocated_nodes[node_of_allocation (p)];
+		}
+		/* Pinned nodes : their local interval is accessed in place by co-located nodes, so their
+		 * regions must stay owned by them. Set on all nodes after all nodes have attached theirs.
+		 */
+		void set_pinned (size_t node) { pinned_nodes[node] = true; }
+		bool is_pinned (size_t node) const { return pinned_nodes[node]; }
+
+		/* Remote regions.
+		 * Copies of regions of other nodes are received at their GAS address. The superpages covering
+		 * them are mapped at first use (reserved, committed on touch), and stay mapped until the space
+		 * is destroyed. Not thread safe : called by the coherence progress engine only.
+		 */
+		void map_remote (const Range<Ptr> & region) {
+			ASSERT_SAFE (in_gas (region));
+			ASSERT_SAFE (!in_local_interval (region.first ()));
+			ASSERT_SAFE (!in_colocated_interval (region.first ()));
+			for (auto num : range (superpage_num (region.first ()), superpage_num (region.last () - 1) + 1)) {
+				if (remote_mapped[num])
+					continue;
+				if (VMem::reserve (superpage (num), VMem::superpage_size) != 0)
+					FAILURE ("Gas::Space: remote superpage %p is not free", static_cast<void *> (superpage (num)));
+				remote_mapped[num] = true;
+			}
+		}
 
 		// Superpage management
 		Ptr reserve_local_superpage_sequence (size_t superpage_nb) {
+			size_t search_cursor = 0;
+			return reserve_local_superpage_sequence (superpage_nb, search_cursor);
+		}
+		Ptr reserve_local_superpage_sequence (size_t superpage_nb, size_t & search_cursor,
+		                                      bool prefault = false) {
+			Ptr base = try_reserve_local_superpage_sequence (superpage_nb, search_cursor, prefault);
+			if (base == Ptr (nullptr)) {
+				ASSERT_STD_FAIL ("Gas::Space: local interval is full");
+			}
+			return base;
+		}
+		Ptr try_reserve_local_superpage_sequence (size_t superpage_nb, size_t & search_cursor,
+		                                          bool prefault = false) {
+			/* search_cursor is a caller owned next-fit position, as an offset in the local interval.
+			 * It is updated to point after the reserved sequence.
+			 * Returns nullptr if no free sequence is large enough.
+			 * If prefault is set, the pages are faulted in by the calling thread.
+			 */
 			ASSERT_SAFE (superpage_nb > 0);
-			auto base = superpage (superpage_tracker.acquire (superpage_nb, local_interval_sp));
-			VMem::map_checked (base, VMem::superpage_size * superpage_nb);
+			size_t hint = local_interval_sp.first () + search_cursor % superpage_by_node;
+			size_t num = superpage_tracker.try_acquire (superpage_nb, local_interval_sp, hint);
+			if (num == SuperpageTracker::not_found)
+				return nullptr;
+			search_cursor = num + superpage_nb - local_interval_sp.first ();
+			auto base = superpage (num);
+			mapping.map (base, VMem::superpage_size * superpage_nb, prefault);
 			return base;
 		}
 
+		void prefault_superpage_sequence (Ptr base, size_t superpage_nb) {
+			// For sequences that were reserved without prefault
+			ASSERT_SAFE (in_local_interval (range_from_offset (base, superpage_nb * VMem::superpage_size)));
+			mapping.populate (base, VMem::superpage_size * superpage_nb);
+		}
+
+		/* Release and trim destroy the mapping before clearing the tracker bits.
+		 * While the destroy is ongoing the superpages are still marked as used, so they cannot be
+		 * reserved (and mapped) again by another thread ; a new mapping can never be destroyed (or
+		 * discarded) by a late destroy.
+		 */
 		void release_superpage_sequence (Ptr base, size_t superpage_nb) {
 			ASSERT_SAFE (in_gas (range_from_offset (base, superpage_nb * VMem::superpage_size)));
 			ASSERT_SAFE (superpage_nb > 0);
+			mapping.destroy (base, VMem::superpage_size * superpage_nb);
 			superpage_tracker.release (range_from_offset (superpage_num (base), superpage_nb));
-			VMem::unmap_checked (base, VMem::superpage_size * superpage_nb);
-			// FIXME possible data race if sequence is reserved before
 		}
 
 		void trim_superpage_sequence (Ptr base, size_t superpage_nb) {
 			ASSERT_SAFE (in_gas (range_from_offset (base, superpage_nb * VMem::superpage_size)));
 			ASSERT_SAFE (superpage_nb > 1);
+			mapping.destroy (base + VMem::superpage_size, VMem::superpage_size * (superpage_nb - 1));
 			superpage_tracker.trim (range_from_offset (superpage_num (base), superpage_nb));
-			VMem::unmap_checked (base + VMem::superpage_size, VMem::superpage_size * (superpage_nb - 1));
-			// FIXME same
+		}
+
+		void split_superpage_sequence (Ptr base, size_t superpage_nb) {
+			// Each superpage becomes a sequence of its own, to be released (or trimmed) independently
+			ASSERT_SAFE (in_gas (range_from_offset (base, superpage_nb * VMem::superpage_size)));
+			ASSERT_SAFE (superpage_nb > 1);
+			superpage_tracker.split (range_from_offset (superpage_num (base), superpage_nb));
 		}
 
 		Ptr superpage_sequence_start (Ptr inside) const {
@@ -113,6 +227,17 @@ namespace Gas {
 		}
 #endif
 	};
+
+	/* Lazy mapping by default ; GIVY_EAGER_MAPPING selects the per superpage sequence mmap/munmap,
+	 * GIVY_SHARED_MAPPING the memfd backed local interval that co-located nodes can attach.
+	 */
+#if defined(GIVY_EAGER_MAPPING)
+	using Space = BasicSpace<VMem::EagerMapping>;
+#elif defined(GIVY_SHARED_MAPPING)
+	using Space = BasicSpace<VMem::SharedMapping>;
+#else
+	using Space = BasicSpace<VMem::LazyMapping>;
+#endif
 }
 }
 #endif
@@ -0,0 +1,75 @@
+#define ASSERT_LEVEL_SAFE
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "gas_space.h"
+#include "tests.h"
+
+using namespace Givy;
+
+/* Stress of concurrent reserve/release/trim of superpage sequences.
+ * Each thread marks every superpage of its sequences, then checks the marks are still there before
+ * releasing them. A mapping destroyed by a concurrent release (unmap of a range reserved again by
+ * another thread) shows as a lost mark or a segfault.
+ */
+
+namespace {
+constexpr size_t nb_thread = 8;
+constexpr size_t nb_round = 20000;
+constexpr size_t max_sequence = 3;
+
+void mark (Ptr base, size_t superpage_nb, size_t value) {
+	for (size_t i = 0; i < superpage_nb; ++i)
+		*(base + i * VMem::superpage_size).as<volatile size_t *> () = value;
+}
+size_t count_lost_marks (Ptr base, size_t superpage_nb, size_t value) {
+	size_t lost = 0;
+	for (size_t i = 0; i < superpage_nb; ++i)
+		if (*(base + i * VMem::superpage_size).as<volatile size_t *> () != value)
+			lost++;
+	return lost;
+}
+
+template <typename Mapping> void stress (const char * name) {
+	Gas::BasicSpace<Mapping> space{Ptr (0x4000'0000'0000),    // start
+	                               32 * VMem::superpage_size, // space_by_node
+	                               1,                         // nb_node
+	                               0};                        // local node
+
+	std::atomic<size_t> lost{0};
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nb_thread; ++t)
+		threads.emplace_back ([&space, &lost](size_t thid) {
+			size_t cursor = thid * 4;
+			for (size_t round = 0; round < nb_round; ++round) {
+				size_t value = (thid << 32) | round;
+				size_t n = 1 + (round + thid) % max_sequence;
+				Ptr base = space.reserve_local_superpage_sequence (n, cursor);
+				mark (base, n, value);
+				lost += count_lost_marks (base, n, value);
+				if (n > 1 && round % 2 == 0) {
+					space.trim_superpage_sequence (base, n);
+					lost += count_lost_marks (base, 1, value);
+					n = 1;
+				}
+				space.release_superpage_sequence (base, n);
+			}
+		}, t);
+	for (auto & th : threads)
+		th.join ();
+
+	printf ("Reserve/release stress (%s): %zu threads x %zu rounds, %zu lost marks\n", name, nb_thread,
+	        nb_round, lost.load ());
+	ASSERT_STD (lost == 0);
+}
+}
+
+int main (void) {
+	stress<VMem::EagerMapping> ("eager");
+	stress<VMem::LazyMapping> ("lazy");
+	stress<VMem::SharedMapping> ("shared");
+	return 0;
+}
@@ -2,7 +2,14 @@
  *
  * Defines interface functions
  */
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
 
 #include "allocator.h"
 #include "coherence.h"
@@ -14,17 +21,9 @@
 #include "reporting.h"
 #include "types.h"
 
-#include "instance.h"
-
 namespace Givy {
-	
 
 namespace {
-	// Global static storage structures
-	struct StaticStuff {
-		Allocator::Bootstrap bootstrap_allocator;
-	};
-
 	// Structures for the GAS mode, inited afterwards
 	struct GasStuff {
 		Constructible<Gas::Space> space;
@@ -33,7 +32,7 @@ namespace {
 		bool inited = false;
 
 		GasStuff () = default;
-		void init (int & argc, char **& argv);
+		void init (int & argc, char **& argv, const GasConfig & config);
 		~GasStuff ();
 	};
 
@@ -44,13 +43,108 @@ namespace {
 
 	/* Global structures of the runtime
 	 */
-	StaticStuff global;
 	GasStuff gas;
 	thread_local ThreadStuff thread;
 
 	/* Impl */
 
-	void GasStuff::init (int & argc, char **& argv) {
+	/* Environment parsing ; aborts on malformed values, as a bad GAS layout is not recoverable.
+	 */
+	uintptr_t parse_env_address (const char * name, uintptr_t default_value) {
+		const char * str = std::getenv (name);
+		if (str == nullptr)
+			return default_value;
+		char * end = nullptr;
+		auto value = std::strtoull (str, &end, 0);
+		if (end == str || *end != '\0')
+			FAILURE ("%s: invalid address '%s'", name, str);
+		return value;
+	}
+	size_t parse_env_size (const char * name, size_t default_value) {
+		// A non zero multiple of the superpage size ; strtoull would accept (and negate) a sign
+		const char * str = std::getenv (name);
+		if (str == nullptr)
+			return default_value;
+		const char * digits = str + std::strspn (str, " \t");
+		if (*digits == '-' || *digits == '+')
+			FAILURE ("%s: invalid size '%s'", name, str);
+		char * end = nullptr;
+		errno = 0;
+		size_t value = std::strtoull (digits, &end, 0);
+		if (end == digits || errno == ERANGE)
+			FAILURE ("%s: invalid size '%s'", name, str);
+		size_t nb_shift = 0;
+		switch (*end) {
+		case 'T': nb_shift++; // Fallthrough
+		case 'G': nb_shift++; // Fallthrough
+		case 'M': nb_shift++; // Fallthrough
+		case 'K': nb_shift++; ++end; // Fallthrough
+		case '\0': break;
+		default: FAILURE ("%s: invalid size '%s'", name, str);
+		}
+		if (*end != '\0')
+			FAILURE ("%s: invalid size '%s'", name, str);
+		for (; nb_shift > 0; --nb_shift) {
+			if (value > SIZE_MAX >> 10)
+				FAILURE ("%s: size '%s' is too large", name, str);
+			value <<= 10;
+		}
+		if (value == 0 || value % VMem::superpage_size != 0)
+			FAILURE ("%s: size '%s' is not a non zero multiple of the superpage size (0x%zx)", name, str,
+			         VMem::superpage_size);
+		return value;
+	}
+
+#ifdef GIVY_SHARED_MAPPING
+	/* Shared GAS segments : attach the local interval of nodes on the same host.
+	 * Nodes exchange (host, pid, segment fd) ; the segment memfd of a peer is opened through /proc.
+	 * Peers that cannot be attached are accessed through coherence messages as usual.
+	 * Segments are created by the space constructor, and closed after the coherence termination,
+	 * so they exist during the exchange. Nodes then exchange the attached peers : all nodes know the
+	 * pinned nodes, which keep the ownership of their regions (see Coherence::Manager).
+	 */
+	struct SegmentInfo {
+		char host[64];
+		pid_t pid;
+		int fd;
+	};
+	void attach_colocated_nodes (Gas::Space & space, Network & network) {
+		SegmentInfo local{};
+		gethostname (local.host, sizeof (local.host) - 1);
+		local.pid = getpid ();
+		local.fd = space.local_mapping ().segment_fd ();
+
+		std::vector<SegmentInfo> infos (network.nb_node ());
+		network.all_gather (&local, infos.data (), sizeof (SegmentInfo));
+
+		for (auto node : range (network.nb_node ())) {
+			auto & info = infos[node];
+			if (node == network.node_id () || std::strcmp (info.host, local.host) != 0)
+				continue;
+			char path[64];
+			std::snprintf (path, sizeof (path), "/proc/%d/fd/%d", info.pid, info.fd);
+			int fd = open (path, O_RDWR | O_CLOEXEC);
+			bool attached = fd >= 0 && space.attach_colocated_node (node, fd);
+			if (fd >= 0)
+				close (fd); // The mapping keeps the segment alive
+			DEBUG_TEXT ("[N%zu] co-located node %zu: %s\n", network.node_id (), node,
+			            attached ? "attached" : "attach failed");
+		}
+
+		unsigned long long attached_nodes = 0;
+		for (auto node : range (network.nb_node ()))
+			if (space.in_colocated_interval (space.node_interval (node).first ()))
+				attached_nodes |= 1ull << node;
+		std::vector<unsigned long long> all_attached_nodes (network.nb_node ());
+		network.all_gather (&attached_nodes, all_attached_nodes.data (), sizeof (attached_nodes));
+		for (auto mask : all_attached_nodes)
+			for (auto node : range (network.nb_node ()))
+				if (mask & (1ull << node))
+					space.set_pinned (node);
+	}
+#endif
+
+	void GasStuff::init (int & argc, char **& argv, const GasConfig & config) {
 		ASSERT_STD (!inited);
 		network.construct (argc, argv);
 		auto nb_node = network->nb_node ();
@@ -58,10 +152,14 @@ namespace {
 		ASSERT_STD (nb_node <= Coherence::max_supported_node);
 		DEBUG_TEXT ("[N%zu] Init nb_node=%zu\n", node_id, nb_node);
 
-		// TODO get size & start from env or args
-		auto base_ptr = Ptr (0x4000'0000'0000);
-		space.construct (base_ptr, 100 * VMem::superpage_size, nb_node, node_id,
-		                 global.bootstrap_allocator);
+		ASSERT_STD (config.start % VMem::superpage_size == 0);
+		ASSERT_STD (config.space_by_node % VMem::superpage_size == 0);
+		DEBUG_TEXT ("[N%zu] GAS start=0x%zx size_by_node=0x%zx\n", node_id, config.start,
+		            config.space_by_node);
+		space.construct (Ptr (config.start), config.space_by_node, nb_node, node_id);
+#ifdef GIVY_SHARED_MAPPING
+		attach_colocated_nodes (space.object (), network.object ());
+#endif
 		coherence.construct (space.object (), network.object ());
 
 		inited = true;
@@ -76,13 +174,30 @@ namespace {
 	}
 }
 
+GasConfig GasConfig::from_environment (void) {
+	GasConfig config;
+	config.start = parse_env_address ("GIVY_GAS_START", config.start);
+	config.space_by_node = parse_env_size ("GIVY_GAS_SIZE_BY_NODE", config.space_by_node);
+	return config;
+}
+
 void init (int & argc, char **& argv) {
-	gas.init (argc, argv);
+	init (argc, argv, GasConfig::from_environment ());
+}
+void init (int & argc, char **& argv, const GasConfig & config) {
+	gas.init (argc, argv, config);
 }
 
-Block allocate (size_t size, size_t align) {
+Block allocate (size_t size, size_t align, unsigned flags) {
 	if (gas.inited) {
-		return thread.heap.allocate (size, align, gas.space.object ());
+		return thread.heap.allocate (size, align, gas.space.object (), flags);
+	} else if (flags & GIVY_ALLOC_CACHE_LINE_ISOLATED) {
+		size = Math::align_up (size, VMem::cache_line_size);
+		void * p = nullptr;
+		int r = posix_memalign (&p, std::max (align, VMem::cache_line_size), size);
+		(void) r;
+		ASSERT_STD (r == 0);
+		return {p, size};
 	} else {
 		return {malloc (size), size};
 	}
@@ -92,7 +207,7 @@ void deallocate (void * ptr) {
 	if (!gas.inited || !gas.space->in_gas (ptr)) {
 		free (ptr);
 	} else {
-		// gas.coherence->deallocate (blk, thread.heap);
+		gas.coherence->deallocate (ptr, thread.heap);
 	}
 }
 
@@ -101,14 +216,33 @@ void require_read_only (void * ptr) {
 	gas.coherence->request_region_valid (ptr);
 }
 
+void require_read_only (void * const * ptrs, size_t nb) {
+	ASSERT_SAFE (gas.inited);
+	gas.coherence->request_regions_valid (ptrs, nb);
+}
+
 void require_read_write (void * ptr) {
-	//
+	ASSERT_SAFE (gas.inited);
+	gas.coherence->request_region_writable (ptr);
+}
+void release_read_write (void * ptr) {
+	ASSERT_SAFE (gas.inited);
+	gas.coherence->release_region_writable (ptr);
+}
+
+void prefetch_read_only (Prefetch & handle, void * ptr) {
+	ASSERT_SAFE (gas.inited);
+	ASSERT_SAFE (handle.test ()); // One prefetch at a time
+	gas.coherence->start_region_valid (ptr, handle.query);
 }
 
 // TODO temporary
 std::unique_lock<std::mutex> network_lock (void) {
 	return gas.network->get_lock ();
 }
+bool accessed_in_place (void * ptr) {
+	return gas.space->in_colocated_interval (ptr);
+}
 }
 
 /***************
@@ -120,10 +254,21 @@ void givy_init (int * argc, char ** argv[]) {
 	ASSERT_STD (argv != nullptr);
 	Givy::init (*argc, *argv);
 }
+void givy_init_gas (int * argc, char ** argv[], uintptr_t gas_start, size_t gas_space_by_node) {
+	ASSERT_STD (argc != nullptr);
+	ASSERT_STD (argv != nullptr);
+	Givy::GasConfig config;
+	config.start = gas_start;
+	config.space_by_node = gas_space_by_node;
+	Givy::init (*argc, *argv, config);
+}
 
 struct givy_block givy_allocate (size_t size, size_t align) {
 	return Givy::allocate (size, align);
 }
+struct givy_block givy_allocate_flags (size_t size, size_t align, unsigned flags) {
+	return Givy::allocate (size, align, flags);
+}
 void givy_deallocate (void * ptr) {
 	Givy::deallocate (ptr);
 }
@@ -131,6 +276,12 @@ void givy_deallocate (void * ptr) {
 void givy_require_read_only (void * ptr) {
 	Givy::require_read_only (ptr);
 }
+void givy_require_read_only_n (void * const * ptrs, size_t nb) {
+	Givy::require_read_only (ptrs, nb);
+}
 void givy_require_read_write (void * ptr) {
 	Givy::require_read_write (ptr);
 }
+void givy_release_read_write (void * ptr) {
+	Givy::release_read_write (ptr);
+}
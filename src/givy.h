@@ -3,27 +3,93 @@
 #define GIVY_H
 
 #include "block.h"
+#include "coherence_waiter.h"
 
+#include <cstdint>
 #include <mutex>
 
 namespace Givy {
 
+/* GAS placement and size.
+ * The GAS is [start, start + space_by_node * nb_node) ; it must be free in the address space of all
+ * nodes, and below the end of the user address space. Only tracking tables (a few bytes per
+ * superpage) are reserved upfront, and they are only committed by the kernel when touched.
+ */
+struct GasConfig {
+	uintptr_t start = 0x4000'0000'0000;
+	size_t space_by_node = size_t (64) << 30; // 64GiB
+
+	/* Defaults overridden by environment variables :
+	 * GIVY_GAS_START (address, decimal or 0x hex), GIVY_GAS_SIZE_BY_NODE (bytes, K/M/G/T suffix).
+	 */
+	static GasConfig from_environment (void);
+};
+
 /* Init
  */
-void init (int & argc, char **& argv);
+void init (int & argc, char **& argv); // Uses GasConfig::from_environment ()
+void init (int & argc, char **& argv, const GasConfig & config);
 
 /* Allocator interface
+ * flags is a combination of givy_alloc_flags.
  */
-Block allocate (size_t size, size_t align);
+Block allocate (size_t size, size_t align, unsigned flags = GIVY_ALLOC_DEFAULT);
 void deallocate (void * ptr);
 
 /* Coherence interface
+ * ptr is the start of a region (as returned by allocate).
+ * require_read_only gets a valid copy of the region ; require_read_write gets the only valid copy.
+ * A copy stays valid until a write is required on another node ; ordering of the accesses to a
+ * region from different nodes is up to the application.
+ * Each require_read_write starts a write section, ended by release_read_write : other nodes wait
+ * for the end of the section to access the region, so sections must not wait for other nodes.
+ * With GIVY_SHARED_MAPPING, nodes on the same host access the regions of each other in place : such
+ * regions can only be written by their allocation node. require_read_write on another node aborts
+ * the calling process, before any request is sent.
  */
 void require_read_only (void * ptr);
 void require_read_write (void * ptr);
+void release_read_write (void * ptr);
+
+/* require_read_only on each of the nb regions of ptrs, sending all requests before waiting.
+ * Requests to the same node are grouped in one message ; the call waits for the slowest answer
+ * instead of the sum of all round trips.
+ */
+void require_read_only (void * const * ptrs, size_t nb);
+
+/* Asynchronous read only acquire.
+ * prefetch_read_only starts getting a valid copy of the region and returns immediately ; the
+ * request is then answered in the background. wait (handle) blocks until the copy is valid, which
+ * is then equivalent to require_read_only ; test (handle) only checks.
+ * A handle tracks one prefetch at a time. It is not movable, and must not be destroyed before its
+ * prefetch is complete (the destructor waits for it).
+ */
+class Prefetch {
+private:
+	Coherence::Waiter waiter;
+	Coherence::Query query{waiter};
+	friend void prefetch_read_only (Prefetch & handle, void * ptr);
+
+public:
+	Prefetch () = default;
+	Prefetch (const Prefetch &) = delete;
+	Prefetch & operator= (const Prefetch &) = delete;
+	~Prefetch () { wait (); }
+
+	bool test (void) const { return waiter.done (); }
+	void wait (void) { waiter.wait (); }
+};
+void prefetch_read_only (Prefetch & handle, void * ptr);
+inline bool test (const Prefetch & handle) {
+	return handle.test ();
+}
+inline void wait (Prefetch & handle) {
+	handle.wait ();
+}
 
 // TODO temporary for tests
 std::unique_lock<std::mutex> network_lock (void);
+bool accessed_in_place (void * ptr); // Region of a co-located node (GIVY_SHARED_MAPPING)
 
 }
 
@@ -4,17 +4,23 @@
 
 #include "block.h"
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void givy_init (int * argc, char **argv[]);
+void givy_init_gas (int * argc, char **argv[], uintptr_t gas_start, size_t gas_space_by_node);
 
 struct givy_block givy_allocate (size_t size, size_t align);
+struct givy_block givy_allocate_flags (size_t size, size_t align, unsigned flags);
 void givy_deallocate (void * ptr);
 
 void givy_require_read_only (void * ptr);
+void givy_require_read_only_n (void * const * ptrs, size_t nb);
 void givy_require_read_write (void * ptr);
+void givy_release_read_write (void * ptr);
 
 #ifdef __cplusplus
 } // extern
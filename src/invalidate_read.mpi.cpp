@@ -0,0 +1,76 @@
+#include <cstdio>
+#include <mpi.h>
+#include <vector>
+
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Reads racing with writes (invalidation overtaking a data answer).
+ * Run with several ranks. At each round, rank 0 allocates regions, which the writer of the round
+ * reads first (so that ownership moves without data). Then the writer takes all regions for writing
+ * while the other ranks read them : an invalidation of the new owner may reach a reader before the
+ * answer of the previous owner. Readers must see the value before or after the write, and after the
+ * next barrier, the value of the write.
+ */
+
+namespace {
+constexpr size_t nb_round = 50;
+constexpr size_t nb_region = 32;
+constexpr size_t region_sizes[] = {64, 5000}; // Small and medium
+
+size_t initial_value (size_t round, size_t r) {
+	return (round * nb_region + r) * 2;
+}
+size_t & value (void * p) {
+	return *static_cast<size_t *> (p);
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+
+	size_t errors = 0;
+	for (size_t round = 0; round < nb_round; ++round) {
+		int writer = 1 + int(round % size_t (nb_rank - 1));
+		std::vector<void *> regions (nb_region);
+		if (rank == 0)
+			for (size_t r = 0; r < nb_region; ++r) {
+				regions[r] = Givy::allocate (region_sizes[r % 2], 1).ptr;
+				value (regions[r]) = initial_value (round, r);
+			}
+		broadcast_pointers (regions.data (), nb_region, 0);
+		if (rank == writer)
+			Givy::require_read_only (regions.data (), nb_region);
+		mpi_barrier ();
+
+		for (size_t r = 0; r < nb_region; ++r) {
+			if (rank == writer) {
+				Givy::require_read_write (regions[r]);
+				value (regions[r])++;
+				Givy::release_read_write (regions[r]);
+			} else {
+				Givy::require_read_only (regions[r]);
+				size_t v = value (regions[r]);
+				if (v != initial_value (round, r) && v != initial_value (round, r) + 1)
+					errors++;
+			}
+		}
+		mpi_barrier (); // All writes done
+
+		for (size_t r = 0; r < nb_region; ++r) {
+			Givy::require_read_only (regions[r]);
+			if (value (regions[r]) != initial_value (round, r) + 1)
+				errors++;
+		}
+		mpi_barrier (); // All reads done before the deallocations
+		for (auto p : regions)
+			Givy::deallocate (p);
+	}
+	printf ("[N%d] %zu rounds of reads racing with writes: %zu errors\n", rank, nb_round, errors);
+	ASSERT_STD (errors == 0);
+	return 0;
+}
@@ -3,14 +3,19 @@
 #define GIVY_MEMORY_MAPPING_H
 
 #include <cerrno>
+#include <cstdlib>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include "reporting.h"
+#include "system.h"
+
 namespace Givy {
 namespace VMem {
-	static inline int map (void * page_start, size_t size) {
+	static inline int map (void * page_start, size_t size, bool populate = false) {
+		// MAP_POPULATE prefaults the pages (best effort, never fails the mapping)
 		void * p = mmap (page_start, size, PROT_READ | PROT_WRITE | PROT_EXEC,
-		                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+		                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | (populate ? MAP_POPULATE : 0), -1, 0);
 		if (p == MAP_FAILED || p != page_start)
 			return -1;
 		else
@@ -21,8 +26,28 @@ namespace VMem {
 		return madvise (page_start, size, MADV_DONTNEED);
 	}
 
-	static inline void map_checked (void * page_start, size_t size) {
-		int map_r = map (page_start, size);
+	static inline int remove (void * page_start, size_t size) {
+		// Discard for shared mappings : also frees the pages of the backing file
+		return madvise (page_start, size, MADV_REMOVE);
+	}
+
+	static inline void populate (void * page_start, size_t size) {
+		/* Prefault pages of an existing mapping, as if written by the calling thread (first touch NUMA
+		 * placement). Best effort : MADV_POPULATE_WRITE (Linux 5.14) may fail under memory pressure.
+		 * Older kernels reject it, so touch each page instead ; the area must not be in use yet.
+		 */
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+		if (madvise (page_start, size, MADV_POPULATE_WRITE) == 0 || errno != EINVAL)
+			return;
+		auto * bytes = static_cast<volatile char *> (page_start);
+		for (size_t offset = 0; offset < size; offset += page_size)
+			bytes[offset] = bytes[offset];
+	}
+
+	static inline void map_checked (void * page_start, size_t size, bool populate = false) {
+		int map_r = map (page_start, size, populate);
 		ASSERT_OPT (map_r == 0);
 	}
 	static inline void unmap_checked (void * page_start, size_t size) {
@@ -33,12 +58,109 @@ namespace VMem {
 		int discard_r = discard (page_start, size);
 		ASSERT_OPT (discard_r == 0);
 	}
+	static inline void remove_checked (void * page_start, size_t size) {
+		int remove_r = remove (page_start, size);
+		ASSERT_OPT (remove_r == 0);
+	}
+
+	static inline void * reserve_anywhere (size_t size) {
+		// Reserve without committing ; pages are zero-filled and committed on first touch
+		void * p = mmap (nullptr, size, PROT_READ | PROT_WRITE,
+		                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		ASSERT_OPT (p != MAP_FAILED);
+		return p;
+	}
 
 	static inline void * map_anywhere (size_t size) {
 		void * p = mmap (nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 		ASSERT_OPT (p != MAP_FAILED);
 		return p;
 	}
+
+	static inline int reserve (void * page_start, size_t size) {
+		/* Reserve a fixed area without committing it.
+		 * No MAP_FIXED : fails instead of replacing existing mappings in the area (bootstrap allocator
+		 * memory, tracker tables, libraries).
+		 */
+		void * p = mmap (page_start, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+		                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (p == MAP_FAILED)
+			return -1;
+		if (p != page_start) {
+			munmap (p, size);
+			return -1;
+		}
+		return 0;
+	}
+
+	static inline int map_shared_file (void * page_start, size_t size, int fd) {
+		// Shared mapping of a file at a fixed area ; no MAP_FIXED, as for reserve
+		void * p = mmap (page_start, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+		                 MAP_SHARED | MAP_NORESERVE, fd, 0);
+		if (p == MAP_FAILED)
+			return -1;
+		if (p != page_start) {
+			munmap (p, size);
+			return -1;
+		}
+		return 0;
+	}
+
+	/* Virtual mapping policies of an area (the local GAS interval).
+	 * setup/cleanup are called once for the whole area, map/destroy for each superpage sequence.
+	 * populate prefaults an already mapped part ; map can also prefault the new sequence.
+	 * - Eager: each superpage sequence has its own mapping, created and removed with it.
+	 * - Lazy: the area is reserved once ; map is a no-op and destroy only discards the pages.
+	 *   No VMA is created, split or merged after setup, so the kernel mmap lock is not taken.
+	 * - Shared: as Lazy, but the area is backed by a memfd. Other processes of the host can map it
+	 *   (from /proc/<pid>/fd/<segment_fd>) to access the same physical memory.
+	 * Policies with state are stored in the Gas::Space.
+	 */
+	struct EagerMapping {
+		static void setup (void *, size_t) {}
+		static void cleanup (void *, size_t) {}
+		static void map (void * page_start, size_t size, bool prefault) {
+			map_checked (page_start, size, prefault);
+		}
+		static void populate (void * page_start, size_t size) { VMem::populate (page_start, size); }
+		static void destroy (void * page_start, size_t size) { unmap_checked (page_start, size); }
+	};
+	struct LazyMapping {
+		static void setup (void * page_start, size_t size) {
+			if (reserve (page_start, size) != 0)
+				FAILURE ("LazyMapping: area [%p, +0x%zx) is not free", page_start, size);
+		}
+		static void cleanup (void * page_start, size_t size) { unmap_checked (page_start, size); }
+		static void map (void * page_start, size_t size, bool prefault) {
+			if (prefault)
+				VMem::populate (page_start, size);
+		}
+		static void populate (void * page_start, size_t size) { VMem::populate (page_start, size); }
+		static void destroy (void * page_start, size_t size) { discard_checked (page_start, size); }
+	};
+	struct SharedMapping {
+		int fd{-1};
+
+		void setup (void * page_start, size_t size) {
+			fd = memfd_create ("givy_gas", MFD_CLOEXEC);
+			if (fd < 0 || ftruncate (fd, size) != 0)
+				FAILURE ("SharedMapping: cannot create segment of 0x%zx bytes", size);
+			if (map_shared_file (page_start, size, fd) != 0)
+				FAILURE ("SharedMapping: area [%p, +0x%zx) is not free", page_start, size);
+		}
+		void cleanup (void * page_start, size_t size) {
+			unmap_checked (page_start, size);
+			close (fd);
+		}
+		static void map (void * page_start, size_t size, bool prefault) {
+			if (prefault)
+				VMem::populate (page_start, size);
+		}
+		static void populate (void * page_start, size_t size) { VMem::populate (page_start, size); }
+		static void destroy (void * page_start, size_t size) { remove_checked (page_start, size); }
+
+		int segment_fd (void) const { return fd; }
+	};
 }
 }
 
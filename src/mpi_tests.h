@@ -0,0 +1,63 @@
+#pragma once
+#ifndef GIVY_MPI_TESTS_H
+#define GIVY_MPI_TESTS_H
+
+#include <mpi.h>
+#include <vector>
+
+#include "givy.h"
+
+/* Helpers for MPI tests and benchmarks.
+ * MPI calls are serialized with the coherence thread by the network lock. Waits for other ranks do
+ * not hold it : other ranks may need answers from this one before they reach the collective.
+ */
+
+inline void mpi_barrier (void) {
+	MPI_Request request;
+	{
+		auto lock = Givy::network_lock ();
+		MPI_Ibarrier (MPI_COMM_WORLD, &request);
+	}
+	int done = 0;
+	while (!done) {
+		auto lock = Givy::network_lock ();
+		MPI_Test (&request, &done, MPI_STATUS_IGNORE);
+	}
+}
+
+// All ranks give the same number of pointers ; result is ordered by rank
+inline std::vector<void *> all_gather_pointers (const std::vector<void *> & local) {
+	auto lock = Givy::network_lock ();
+	int nb_rank;
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+	std::vector<void *> ptrs (local.size () * nb_rank);
+	int bytes = int(local.size () * sizeof (void *));
+	MPI_Allgather (local.data (), bytes, MPI_BYTE, ptrs.data (), bytes, MPI_BYTE, MPI_COMM_WORLD);
+	return ptrs;
+}
+inline std::vector<void *> all_gather_pointers (void * ptr) {
+	return all_gather_pointers (std::vector<void *>{ptr});
+}
+
+// Element-wise sum over all ranks, in place ; waits like mpi_barrier
+inline void all_reduce_sum (std::vector<size_t> & values) {
+	static_assert (sizeof (size_t) == sizeof (unsigned long), "MPI_UNSIGNED_LONG for size_t");
+	MPI_Request request;
+	{
+		auto lock = Givy::network_lock ();
+		MPI_Iallreduce (MPI_IN_PLACE, values.data (), int(values.size ()), MPI_UNSIGNED_LONG, MPI_SUM,
+		                MPI_COMM_WORLD, &request);
+	}
+	int done = 0;
+	while (!done) {
+		auto lock = Givy::network_lock ();
+		MPI_Test (&request, &done, MPI_STATUS_IGNORE);
+	}
+}
+
+inline void broadcast_pointers (void ** ptrs, size_t nb, int root) {
+	auto lock = Givy::network_lock ();
+	MPI_Bcast (ptrs, int(nb * sizeof (void *)), MPI_BYTE, root, MPI_COMM_WORLD);
+}
+
+#endif
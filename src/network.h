@@ -4,8 +4,10 @@
 
 #include <mpi.h>
 
+#include <climits>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include "reporting.h"
 
@@ -19,6 +21,10 @@ private:
 	std::mutex mutex;
 
 	static constexpr int protocol_tag{42};
+	static constexpr int data_tag{43}; // Region contents, following a protocol message
+
+	// Data sends in flight ; their buffers are regions, which must not change until completion
+	std::vector<MPI_Request> pending_sends;
 
 public:
 	Network (int & argc, char **& argv) {
@@ -28,19 +34,49 @@ public:
 		MPI_Comm_rank (MPI_COMM_WORLD, &comm_rank);
 		MPI_Comm_size (MPI_COMM_WORLD, &comm_size);
 	}
-	~Network () { MPI_Finalize (); }
+	~Network () {
+		MPI_Waitall (pending_sends.size (), pending_sends.data (), MPI_STATUSES_IGNORE);
+		MPI_Finalize ();
+	}
 
 	size_t node_id (void) const { return static_cast<size_t> (comm_rank); }
 	size_t nb_node (void) const { return static_cast<size_t> (comm_size); }
 
-	void send_to (size_t to, void * data, size_t size) {
+	void send_to (size_t to, const void * data, size_t size) {
 		std::lock_guard<std::mutex> lock (mutex);
 		DEBUG_TEXT ("[N%d] sending %zu bytes to %zu\n", comm_rank, size, to);
 		MPI_Send (data, size, MPI_BYTE, to, protocol_tag, MPI_COMM_WORLD);
 	}
 
+	/* Region contents, without intermediate buffer.
+	 * send_data_to does not block : the send completes during later calls.
+	 * Data messages from a node are received in the order they were sent ; recv_data_from blocks
+	 * until the data is received in the given buffer.
+	 */
+	void send_data_to (size_t to, const void * data, size_t size) {
+		ASSERT_STD (size <= INT_MAX);
+		std::lock_guard<std::mutex> lock (mutex);
+		DEBUG_TEXT ("[N%d] sending %zu data bytes to %zu\n", comm_rank, size, to);
+		MPI_Request request;
+		MPI_Isend (data, size, MPI_BYTE, to, data_tag, MPI_COMM_WORLD, &request);
+		pending_sends.push_back (request);
+	}
+	void recv_data_from (size_t from, void * data, size_t size) {
+		ASSERT_STD (size <= INT_MAX);
+		std::lock_guard<std::mutex> lock (mutex);
+		complete_sends (); // The buffer may be the source of an earlier send
+		MPI_Recv (data, size, MPI_BYTE, from, data_tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+
+	// Collective : every node gets the size bytes of data of all nodes, ordered by node id
+	void all_gather (const void * data, void * gathered, size_t size) {
+		std::lock_guard<std::mutex> lock (mutex);
+		MPI_Allgather (data, size, MPI_BYTE, gathered, size, MPI_BYTE, MPI_COMM_WORLD);
+	}
+
 	std::unique_ptr<char[]> try_recv (size_t & from) {
 		std::lock_guard<std::mutex> lock (mutex);
+		complete_sends ();
 		std::unique_ptr<char[]> data;
 		int flag = 0;
 		MPI_Status status;
@@ -57,6 +93,22 @@ public:
 		return data;
 	}
 
+private:
+	void complete_sends (void) {
+		// Under lock ; drops completed requests (set to MPI_REQUEST_NULL by MPI_Test)
+		if (pending_sends.empty ())
+			return;
+		size_t kept = 0;
+		for (auto & request : pending_sends) {
+			int done = 0;
+			MPI_Test (&request, &done, MPI_STATUS_IGNORE);
+			if (!done)
+				pending_sends[kept++] = request;
+		}
+		pending_sends.resize (kept);
+	}
+
+public:
 	// TODO temporary for tests
 	std::unique_lock<std::mutex> get_lock (void) {
 		std::unique_lock<std::mutex> lock (mutex);
@@ -0,0 +1,78 @@
+#include <cstdio>
+#include <mpi.h>
+#include <vector>
+
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Prefetch test.
+ * Run with several ranks : each rank fills blocks of its local interval, then reads the blocks of
+ * all ranks in a pipeline, prefetching the next blocks while checking the current one. Some blocks
+ * are polled with test () before wait (), and the same block is sometimes prefetched twice.
+ */
+
+namespace {
+constexpr size_t nb_block = 64;
+constexpr size_t block_size = 8 << 10;
+constexpr size_t depth = 8; // Prefetches in flight
+
+unsigned char pattern (int rank, size_t block, size_t i) {
+	return static_cast<unsigned char> (rank * 13 + block * 5 + i);
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+
+	std::vector<void *> locals (nb_block);
+	for (size_t b = 0; b < nb_block; ++b) {
+		auto p = static_cast<unsigned char *> (Givy::allocate (block_size, 1).ptr);
+		for (size_t i = 0; i < block_size; ++i)
+			p[i] = pattern (rank, b, i);
+		locals[b] = p;
+	}
+	auto blocks = all_gather_pointers (locals);
+
+	// Starting with the next rank, so that ranks do not read the same blocks at the same time
+	size_t nb = blocks.size ();
+	auto block_index = [&](size_t n) { return (size_t (rank + 1) * nb_block + n) % nb; };
+	std::vector<Givy::Prefetch> handles (depth);
+	for (size_t n = 0; n < depth && n < nb; ++n)
+		Givy::prefetch_read_only (handles[n], blocks[block_index (n)]);
+
+	size_t errors = 0;
+	size_t nb_polled = 0;
+	for (size_t n = 0; n < nb; ++n) {
+		auto & handle = handles[n % depth];
+		if (n % 3 == 0)
+			while (!Givy::test (handle))
+				nb_polled++;
+		Givy::wait (handle);
+
+		size_t index = block_index (n);
+		auto p = static_cast<const unsigned char *> (blocks[index]);
+		for (size_t i = 0; i < block_size; ++i)
+			if (p[i] != pattern (int(index / nb_block), index % nb_block, i))
+				errors++;
+
+		if (n + depth < nb)
+			Givy::prefetch_read_only (handle, blocks[block_index (n + depth)]);
+		if (n % 5 == 0) {
+			// Already valid or already requested : completes without any new request
+			Givy::Prefetch again;
+			Givy::prefetch_read_only (again, blocks[index]);
+			ASSERT_STD (Givy::test (again));
+		}
+	}
+	printf ("[N%d] prefetched %zu blocks (%zu polls): %zu errors\n", rank, nb, nb_polled, errors);
+	ASSERT_STD (errors == 0);
+
+	mpi_barrier ();
+	for (auto p : locals)
+		Givy::deallocate (p);
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include <cstdio>
+#include <mpi.h>
+#include <vector>
+
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Read-write coherence test (ownership transfer and invalidation).
+ * Run with several ranks. Ranks increment shared counters in turn, each turn separated by a
+ * barrier : ownership moves around the ranks, and requests are forwarded from the allocation node.
+ * Between rounds all ranks read the counters, so that each write has to invalidate all the copies.
+ */
+
+namespace {
+constexpr size_t nb_round = 20;
+constexpr size_t counter_sizes[] = {2 * sizeof (size_t), 5000, 3 << 20}; // Small, medium and huge
+constexpr size_t nb_counter = sizeof (counter_sizes) / sizeof (size_t);
+
+// Counter value is stored at both ends of the region
+size_t & counter_front (void * p) {
+	return *static_cast<size_t *> (p);
+}
+size_t & counter_back (void * p, size_t size) {
+	return *reinterpret_cast<size_t *> (static_cast<char *> (p) + size - sizeof (size_t));
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+
+	// Counters allocated by the last rank
+	std::vector<void *> counters (nb_counter);
+	for (size_t c = 0; c < nb_counter; ++c) {
+		void * p = nullptr;
+		if (rank == nb_rank - 1) {
+			p = Givy::allocate (counter_sizes[c], 1).ptr;
+			counter_front (p) = counter_back (p, counter_sizes[c]) = 0;
+		}
+		counters[c] = all_gather_pointers (p)[nb_rank - 1];
+	}
+
+	size_t errors = 0;
+	for (size_t round = 0; round < nb_round; ++round) {
+		for (int turn = 0; turn < nb_rank; ++turn) {
+			if (turn == rank)
+				for (size_t c = 0; c < nb_counter; ++c) {
+					Givy::require_read_write (counters[c]);
+					counter_front (counters[c])++;
+					counter_back (counters[c], counter_sizes[c])++;
+					Givy::release_read_write (counters[c]);
+				}
+			mpi_barrier ();
+		}
+		// Everyone reads the counters
+		size_t expected = (round + 1) * nb_rank;
+		for (size_t c = 0; c < nb_counter; ++c) {
+			Givy::require_read_only (counters[c]);
+			if (counter_front (counters[c]) != expected ||
+			    counter_back (counters[c], counter_sizes[c]) != expected)
+				errors++;
+		}
+		mpi_barrier ();
+	}
+	printf ("[N%d] %zu rounds of %d writers: %zu errors\n", rank, nb_round, nb_rank, errors);
+	ASSERT_STD (errors == 0);
+
+	mpi_barrier ();
+	if (rank == nb_rank - 1)
+		for (auto p : counters)
+			Givy::deallocate (p);
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include <cstdio>
+#include <cstring>
+#include <mpi.h>
+#include <vector>
+
+#include "benchmark.h"
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Remote read latency and bandwidth, by region size.
+ * Rank 0 owns the regions ; every other rank times require_read_only on each of them (one full
+ * DataRequest / DataAnswer round trip, as each region is read once).
+ * With a prefetch depth, the next regions are prefetched while waiting for the current one : the
+ * latency is then the remaining wait time, and requests overlap.
+ * Batched reads acquire all regions with one require_read_only call (one request message).
+ * Usage: mpirun -np 2 bench_remote_read
+ */
+
+namespace {
+std::vector<void *> create_regions (int rank, size_t size, size_t nb) {
+	std::vector<void *> ptrs (nb);
+	if (rank == 0)
+		for (auto & p : ptrs) {
+			p = Givy::allocate (size, 1).ptr;
+			std::memset (p, rank + 1, size);
+		}
+	broadcast_pointers (ptrs.data (), nb, 0);
+	return ptrs;
+}
+void destroy_regions (int rank, const std::vector<void *> & ptrs) {
+	mpi_barrier ();
+	if (rank == 0)
+		for (auto p : ptrs)
+			Givy::deallocate (p);
+}
+
+void read_regions (int rank, size_t size, size_t nb, size_t depth) {
+	auto ptrs = create_regions (rank, size, nb);
+	if (rank != 0) {
+		latency_samples lat;
+		lat.reserve (nb);
+		std::vector<Givy::Prefetch> handles (depth);
+		auto start = now_ns ();
+		for (size_t n = 0; n < depth && n < nb; ++n)
+			Givy::prefetch_read_only (handles[n], ptrs[n]);
+		for (size_t n = 0; n < nb; ++n) {
+			auto t0 = now_ns ();
+			if (depth > 0) {
+				auto & handle = handles[n % depth];
+				Givy::wait (handle);
+				if (n + depth < nb)
+					Givy::prefetch_read_only (handle, ptrs[n + depth]);
+			} else {
+				Givy::require_read_only (ptrs[n]);
+			}
+			lat.add (now_ns () - t0);
+		}
+		auto duration = now_ns () - start;
+		ASSERT_STD (static_cast<const char *> (ptrs[nb - 1])[size - 1] == 1);
+		std::printf ("[N%d] size=%9zu nb=%4zu depth=%2zu p50=%9lluns p99=%9lluns bandwidth=%8.1fMB/s\n",
+		             rank, size, nb, depth, static_cast<unsigned long long> (lat.percentile (0.50)),
+		             static_cast<unsigned long long> (lat.percentile (0.99)),
+		             double(size * nb) * 1e3 / double(duration));
+	}
+	destroy_regions (rank, ptrs);
+}
+
+void read_regions_batched (int rank, size_t size, size_t nb) {
+	auto ptrs = create_regions (rank, size, nb);
+	if (rank != 0) {
+		auto start = now_ns ();
+		Givy::require_read_only (ptrs.data (), nb);
+		auto duration = now_ns () - start;
+		ASSERT_STD (static_cast<const char *> (ptrs[nb - 1])[size - 1] == 1);
+		std::printf ("[N%d] size=%9zu nb=%4zu batched   total=%9lluns by_region=%9lluns bandwidth=%8.1fMB/s\n",
+		             rank, size, nb, static_cast<unsigned long long> (duration),
+		             static_cast<unsigned long long> (duration / nb),
+		             double(size * nb) * 1e3 / double(duration));
+	}
+	destroy_regions (rank, ptrs);
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	for (size_t size = 64; size <= (size_t (64) << 20); size *= 16) {
+		size_t nb = size <= (size_t (256) << 10) ? 200 : 8;
+		for (size_t depth : {0, 8})
+			read_regions (rank, size, nb, depth);
+		read_regions_batched (rank, size, nb);
+	}
+	return 0;
+}
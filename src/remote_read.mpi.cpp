@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <mpi.h>
+#include <thread>
+#include <vector>
+
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Remote read test (DataRequest / DataAnswer).
+ * Run with several ranks : each rank fills small, medium and huge regions of its local interval,
+ * then reads the regions of all other ranks through require_read_only. Several threads require the
+ * same regions concurrently, so that some of them wait for a request already sent by another.
+ */
+
+namespace {
+constexpr size_t region_sizes[] = {100, 100, 3000, 40000, 3 << 20}; // Two small regions per page
+constexpr size_t nb_region = sizeof (region_sizes) / sizeof (size_t);
+constexpr size_t nb_thread = 4;
+
+unsigned char pattern (int rank, size_t region, size_t i) {
+	return static_cast<unsigned char> (rank * 31 + region * 7 + i);
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+
+	std::vector<std::vector<void *>> regions (nb_region);
+	std::vector<void *> locals (nb_region);
+	for (size_t r = 0; r < nb_region; ++r) {
+		auto p = static_cast<unsigned char *> (Givy::allocate (region_sizes[r], 1).ptr);
+		for (size_t i = 0; i < region_sizes[r]; ++i)
+			p[i] = pattern (rank, r, i);
+		locals[r] = p;
+		regions[r] = all_gather_pointers (p);
+	}
+
+	std::vector<size_t> errors (nb_thread, 0);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nb_thread; ++t)
+		threads.emplace_back ([&](size_t thid) {
+			for (int n = 0; n < nb_rank; ++n) {
+				int node = (rank + 1 + n + thid) % nb_rank; // Also the local node
+				for (size_t r = 0; r < nb_region; ++r) {
+					Givy::require_read_only (regions[r][node]);
+					auto p = static_cast<const unsigned char *> (regions[r][node]);
+					for (size_t i = 0; i < region_sizes[r]; ++i)
+						if (p[i] != pattern (node, r, i))
+							errors[thid]++;
+				}
+			}
+		}, t);
+	for (auto & th : threads)
+		th.join ();
+
+	size_t total = 0;
+	for (auto e : errors)
+		total += e;
+	printf ("[N%d] read regions of %d ranks: %zu errors\n", rank, nb_rank, total);
+	ASSERT_STD (total == 0);
+
+	// Regions must stay allocated until everyone has read them
+	mpi_barrier ();
+	for (auto p : locals)
+		Givy::deallocate (p);
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <mpi.h>
+#include <vector>
+
+#include "givy.h"
+#include "mpi_tests.h"
+#include "reporting.h"
+
+/* Shared GAS segments test (built with GIVY_SHARED_MAPPING).
+ * Run with several ranks on one machine : each rank fills a buffer of its local interval, then reads
+ * the buffers of all other ranks. The segments of all other ranks must be attached (checked with
+ * accessed_in_place), so require_read_only returns without any coherence message, and the data
+ * must be visible directly. Writes of the allocation node are then visible in place too.
+ */
+
+namespace {
+constexpr size_t buffer_size = 3 << 20; // Huge allocation, spanning multiple superpages
+constexpr size_t small_size = 100;
+
+unsigned char pattern (int rank, size_t i) {
+	return static_cast<unsigned char> (rank * 31 + i);
+}
+}
+
+int main (int argc, char * argv[]) {
+	Givy::init (argc, argv);
+	int rank, nb_rank;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &nb_rank);
+
+	auto buffer = static_cast<unsigned char *> (Givy::allocate (buffer_size, 1).ptr);
+	auto small = static_cast<unsigned char *> (Givy::allocate (small_size, 1).ptr);
+	for (size_t i = 0; i < buffer_size; ++i)
+		buffer[i] = pattern (rank, i);
+	for (size_t i = 0; i < small_size; ++i)
+		small[i] = pattern (rank, i);
+
+	auto buffers = all_gather_pointers (buffer);
+	auto smalls = all_gather_pointers (small);
+
+	size_t errors = 0;
+	for (int r = 0; r < nb_rank; ++r) {
+		ASSERT_STD (Givy::accessed_in_place (buffers[r]) == (r != rank));
+		ASSERT_STD (Givy::accessed_in_place (smalls[r]) == (r != rank));
+		Givy::require_read_only (buffers[r]);
+		Givy::require_read_only (smalls[r]);
+		auto remote_buffer = static_cast<const unsigned char *> (buffers[r]);
+		auto remote_small = static_cast<const unsigned char *> (smalls[r]);
+		for (size_t i = 0; i < buffer_size; ++i)
+			if (remote_buffer[i] != pattern (r, i))
+				errors++;
+		for (size_t i = 0; i < small_size; ++i)
+			if (remote_small[i] != pattern (r, i))
+				errors++;
+	}
+	mpi_barrier ();
+
+	// Only the allocation node writes a region shared with co-located nodes
+	Givy::require_read_write (small);
+	small[0]++;
+	Givy::release_read_write (small);
+	mpi_barrier ();
+	for (int r = 0; r < nb_rank; ++r) {
+		Givy::require_read_only (smalls[r]);
+		auto remote_small = static_cast<const unsigned char *> (smalls[r]);
+		if (remote_small[0] != static_cast<unsigned char> (pattern (r, 0) + 1))
+			errors++;
+	}
+	printf ("[N%d] read buffers of %d ranks: %zu errors\n", rank, nb_rank, errors);
+	ASSERT_STD (errors == 0);
+
+	// Buffers must stay allocated until everyone has read them
+	mpi_barrier ();
+	Givy::deallocate (small);
+	Givy::deallocate (buffer);
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include <array>
+#include <thread>
+#include <utility>
+
+#include "superpage_tracker.h"
+#include "benchmark.h"
+
+/* SuperpageTracker acquire/release contention.
+ * Threads repeatedly acquire and release small superpage sequences in a shared search space, without
+ * mapping memory. Compares all threads starting their search at the start of the space, with
+ * per-thread striped next-fit cursors.
+ * Usage: bench_superpage_tracker [workload...] ; no argument runs all workloads.
+ */
+
+namespace {
+using namespace Givy;
+
+template <size_t nb_thread> void acquire_storm (bool next_fit) {
+	/* Each thread keeps a window of live sequences ; each step releases the oldest one and acquires
+	 * a new one of 1 to 4 superpages.
+	 */
+	constexpr size_t superpage_nb = 64 * 1024;
+	constexpr size_t nb_live = 16;
+	constexpr size_t nb_step = 20000;
+	constexpr size_t stripe = 64;
+
+	SuperpageTracker tracker (superpage_nb);
+	const auto space = range (superpage_nb);
+	std::array<latency_samples, nb_thread> lats;
+
+	char name[40];
+	std::snprintf (name, sizeof (name), "acquire_storm/%zu/%s", nb_thread,
+	               next_fit ? "next_fit" : "first_fit");
+	bench_result r{name, "spt", 0, 0, {}, current_rss (), 0};
+	auto start = now_ns ();
+	std::array<std::thread, nb_thread> threads;
+	for (size_t t = 0; t < nb_thread; ++t)
+		threads[t] = std::thread ([&](size_t thid) {
+			auto & lat = lats[thid];
+			lat.reserve (nb_step);
+			xorshift rng (thid);
+			size_t cursor = thid * stripe;
+			std::array<std::pair<size_t, size_t>, nb_live> live; // (first, size) of live sequences
+			live.fill ({0, 0});
+			for (size_t i = 0; i < nb_step; ++i) {
+				auto & slot = live[i % nb_live];
+				if (slot.second > 0)
+					tracker.release (range_from_offset (slot.first, slot.second));
+				size_t n = rng.in (1, 5);
+				auto t0 = now_ns ();
+				size_t s = next_fit ? tracker.acquire (n, space, cursor) : tracker.acquire (n, space);
+				lat.add (now_ns () - t0);
+				cursor = (s + n) % superpage_nb;
+				slot = {s, n};
+			}
+			for (auto & slot : live)
+				if (slot.second > 0)
+					tracker.release (range_from_offset (slot.first, slot.second));
+		}, t);
+	for (auto & th : threads)
+		th.join ();
+	r.duration_ns = now_ns () - start;
+	r.rss_after = current_rss ();
+	for (auto & l : lats)
+		r.latency.merge (l);
+	r.nb_ops = r.latency.samples.size ();
+	r.print ();
+}
+}
+
+int main (int argc, char * argv[]) {
+	if (bench_selected (argc, argv, "acquire_storm")) {
+		for (bool next_fit : {false, true}) {
+			acquire_storm<1> (next_fit);
+			acquire_storm<4> (next_fit);
+			acquire_storm<32> (next_fit);
+		}
+	}
+	return 0;
+}
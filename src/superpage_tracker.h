@@ -2,7 +2,9 @@
 #ifndef GIVY_SUPERPAGE_TRACKER_H
 #define GIVY_SUPERPAGE_TRACKER_H
 
+#include <algorithm>
 #include <atomic>
+#include <limits>
 #include <tuple>
 #include <utility>
 
@@ -13,7 +15,7 @@
 #include "bitmask.h"
 
 namespace Givy {
-template <typename Alloc> class SuperpageTracker {
+class SuperpageTracker {
 	/* Tracks the state of superpages.
 	 *
 	 * Check if a superpage is used by the allocator.
@@ -23,6 +25,12 @@ template <typename Alloc> class SuperpageTracker {
 	 * Acquire/release/reads can be called concurrently.
 	 * Calling release twice for the same block is UB.
 	 * Calling release concurrently with a test for the same block is UB.
+	 *
+	 * Memory orderings :
+	 * - mapping_table bits represent ownership : setting them is an acquire RMW, clearing them a
+	 * release. Other table accesses of the owner are ordered between these, and are relaxed.
+	 * - search loads are relaxed : values are only used as expected values of the acquire CAS.
+	 * - lookups are relaxed : a caller has the superpage number from an acquire it is ordered after.
 	 */
 private:
 	using IntType = std::uintmax_t;
@@ -35,21 +43,51 @@ private:
 	 * sequence_table bits: superpage sequence
 	 * 	0: superpages after the first
 	 * 	1: first superpage of sequence
+	 * full_summary_table bits: one per mapping_table cell
+	 * 	0: cell has free superpages
+	 * 	1: cell is full (all ones)
+	 *
+	 * full_summary_table is a search hint, updated after each mapping_table modification.
+	 * It lets acquire skip full regions with one load per 64 cells.
+	 *
+	 * start_table stores, for each superpage of an acquired sequence, the superpage number of the
+	 * sequence start. It is written by acquire, and gives get_sequence_start_num in one load
+	 * whatever the sequence size. Entries of free superpages are stale.
+	 *
+	 * Tables are MappedArray : zero (free) at start, and only committed where superpages are used.
+	 * A GAS of terabytes per node only costs the touched parts of the tables.
 	 */
+	using StartNumType = std::uint32_t;
+
 	size_t table_size;
-	FixedArray<AtomicIntType, Alloc> mapping_table;
-	FixedArray<AtomicIntType, Alloc> sequence_table;
+	MappedArray<AtomicIntType> mapping_table;
+	MappedArray<AtomicIntType> sequence_table;
+	MappedArray<AtomicIntType> full_summary_table;
+	MappedArray<std::atomic<StartNumType>> start_table;
 
 public:
-	SuperpageTracker (size_t superpage_nb, Alloc & allocator_);
-	// No copy/move due to FixedArray
+	explicit SuperpageTracker (size_t superpage_nb);
+	// No copy/move due to MappedArray
 
 	/* Aquire/Release a superpage block, by superpage number.
 	 * Trim will reduce a superpage block to 1 superpage.
+	 *
+	 * acquire searches from search_hint (next-fit), then wraps around to the start of the search
+	 * space. Callers should keep one hint per thread, so that concurrent acquires start in different
+	 * regions instead of competing for the same first free bits.
+	 * try_acquire returns not_found instead of failing if there is no free sequence.
+	 *
+	 * Split turns an owned superpage block into independent 1 superpage blocks.
 	 */
+	static constexpr size_t not_found = std::numeric_limits<size_t>::max ();
 	size_t acquire (size_t superpage_nb, const Range<size_t> & superpage_search_space);
+	size_t acquire (size_t superpage_nb, const Range<size_t> & superpage_search_space,
+	                size_t search_hint);
+	size_t try_acquire (size_t superpage_nb, const Range<size_t> & superpage_search_space,
+	                    size_t search_hint);
 	void release (const Range<size_t> & superpage_sequence);
 	void trim (const Range<size_t> & superpage_sequence);
+	void split (const Range<size_t> & superpage_sequence);
 
 	/* Get superpage block start
 	 */
@@ -80,10 +118,6 @@ private:
 				return Index (array_idx, bit_idx + 1);
 		}
 		Index next_array_cell_first_bit (void) const { return Index (array_idx + 1, 0); }
-		Index prev_array_cell_last_bit (void) const {
-			ASSERT_SAFE (array_idx > 0);
-			return Index (array_idx - 1, BitArray::bits - 1);
-		}
 
 		bool operator<(const Index & rhs) const {
 			return std::tie (array_idx, bit_idx) < std::tie (rhs.array_idx, rhs.bit_idx);
@@ -93,6 +127,12 @@ private:
 		}
 	};
 
+	size_t acquire_in (size_t superpage_nb, const Range<size_t> & superpage_search_space);
+
+	// Summary helpers
+	void update_full_summary (size_t array_idx);
+	size_t next_non_full_cell (size_t array_idx, size_t end_array_idx) const;
+
 	// Bit manipulation helpers
 
 	// Raw manipulators (clear exactly what is requested)
@@ -108,30 +148,72 @@ private:
 	void trim_bits (Index loc_start, Index loc_end);
 };
 
-template <typename Alloc>
-inline SuperpageTracker<Alloc>::SuperpageTracker (size_t superpage_nb, Alloc & allocator_)
+inline SuperpageTracker::SuperpageTracker (size_t superpage_nb)
     : table_size (Math::divide_up (superpage_nb, BitArray::bits)),
-      mapping_table (table_size, allocator_, BitArray::zeros ()),
-      sequence_table (table_size, allocator_, BitArray::zeros ()) {}
+      mapping_table (table_size),
+      sequence_table (table_size),
+      full_summary_table (Math::divide_up (table_size, BitArray::bits)),
+      start_table (superpage_nb) {
+	ASSERT_STD (superpage_nb <= std::numeric_limits<StartNumType>::max ());
+}
+
+inline size_t SuperpageTracker::acquire (size_t superpage_nb,
+                                         const Range<size_t> & superpage_search_space) {
+	return acquire (superpage_nb, superpage_search_space, superpage_search_space.first ());
+}
+
+inline size_t SuperpageTracker::acquire (size_t superpage_nb,
+                                         const Range<size_t> & superpage_search_space,
+                                         size_t search_hint) {
+	size_t found = try_acquire (superpage_nb, superpage_search_space, search_hint);
+	if (found == not_found) {
+		ASSERT_STD_FAIL ("SuperpageTracker: OOM"); // Aborts
+	}
+	return found;
+}
+
+inline size_t SuperpageTracker::try_acquire (size_t superpage_nb,
+                                             const Range<size_t> & superpage_search_space,
+                                             size_t search_hint) {
+	/* Search [hint, last[, then [first, hint + superpage_nb - 1[ for sequences crossing the hint.
+	 */
+	ASSERT_SAFE (superpage_nb > 0);
+	if (superpage_search_space.contains (search_hint) &&
+	    search_hint != superpage_search_space.first ()) {
+		size_t found = acquire_in (superpage_nb, range (search_hint, superpage_search_space.last ()));
+		if (found != not_found)
+			return found;
+		size_t wrap_end = std::min (search_hint + superpage_nb - 1, superpage_search_space.last ());
+		return acquire_in (superpage_nb, range (superpage_search_space.first (), wrap_end));
+	} else {
+		return acquire_in (superpage_nb, superpage_search_space);
+	}
+}
 
-template <typename Alloc>
-inline size_t SuperpageTracker<Alloc>::acquire (size_t superpage_nb,
-                                                const Range<size_t> & superpage_search_space) {
+inline size_t SuperpageTracker::acquire_in (size_t superpage_nb,
+                                            const Range<size_t> & superpage_search_space) {
 	/* I need to find a sequence of superpage_nb consecutive 0s anywhere in the table.
 	 * For now, I perform a linear search of the table, with some optimisation to prevent
 	 * using an atomic load twice on the same integer array cell if possible.
 	 *
 	 * The linear search will scan the table integer by integer for speed.
+	 * Full integers are skipped using full_summary_table, without loading them.
 	 * Search starts at the start of the node-local virtual addresses segment.
 	 * search_at.bit_idx is taken into account if search starts in the middle of a cell.
+	 * Returns not_found if there is no free sequence in the search space.
 	 */
-	ASSERT_SAFE (superpage_nb > 0);
 
 	auto search_at = Index (superpage_search_space.first ());
 	auto search_end = Index (superpage_search_space.last ());
 	IntType c;
 	while (search_at < search_end) {
-		c = mapping_table[search_at.array_idx].load (std::memory_order_seq_cst);
+		size_t non_full = next_non_full_cell (search_at.array_idx, search_end.array_idx);
+		if (non_full != search_at.array_idx) {
+			search_at = Index (non_full, 0);
+			if (!(search_at < search_end))
+				break;
+		}
+		c = mapping_table[search_at.array_idx].load (std::memory_order_relaxed);
 	continue_no_load:
 
 		if (c == BitArray::ones ()) {
@@ -153,7 +235,7 @@ inline size_t SuperpageTracker<Alloc>::acquire (size_t superpage_nb,
 				 * start.
 				 */
 				auto loc_start = Index (search_at.array_idx, pos);
-				auto loc_end = Index (search_at.array_idx, pos + superpage_nb);
+				auto loc_end = Index (loc_start.superpage_num () + superpage_nb); // May be next cell bit 0
 				if (!set_bits (loc_start, c, loc_end, BitArray::zeros ()))
 					continue;
 				return loc_start.superpage_num ();
@@ -174,10 +256,10 @@ inline size_t SuperpageTracker<Alloc>::acquire (size_t superpage_nb,
 			auto loc_start = Index (search_at.array_idx, BitArray::bits - msb_zeros);
 			auto loc_end = Index (loc_start.superpage_num () + superpage_nb);
 			IntType last_cell_bits = BitArray::window_bound (0, loc_end.bit_idx);
-			if (!(loc_end < search_end))
+			if (search_end < loc_end)
 				break;
 			for (size_t idx = loc_start.array_idx + 1; idx < loc_end.array_idx; ++idx) {
-				c = mapping_table[idx].load (std::memory_order_seq_cst);
+				c = mapping_table[idx].load (std::memory_order_relaxed);
 				if (c != BitArray::zeros ()) {
 					// Zero sequence is not big enough ; restart search from this cell, no need to reload
 					search_at = Index (idx, 0);
@@ -185,7 +267,7 @@ inline size_t SuperpageTracker<Alloc>::acquire (size_t superpage_nb,
 				}
 			}
 			if (last_cell_bits != BitArray::zeros ()) {
-				c = mapping_table[loc_end.array_idx].load (std::memory_order_seq_cst);
+				c = mapping_table[loc_end.array_idx].load (std::memory_order_relaxed);
 				if ((c & last_cell_bits) != BitArray::zeros ()) {
 					// Sequence not big enough, restart from this cell, no need to reload
 					search_at = loc_end;
@@ -204,115 +286,172 @@ inline size_t SuperpageTracker<Alloc>::acquire (size_t superpage_nb,
 		// Not found, go to next cell
 		search_at = search_at.next_array_cell_first_bit ();
 	}
-	ASSERT_STD_FAIL ("SuperpageTracker: OOM");
-	return 0;
+	return not_found;
 }
 
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::release (const Range<size_t> & superpage_sequence) {
+inline void SuperpageTracker::release (const Range<size_t> & superpage_sequence) {
 	/* Just clear the bits in the two tables.
 	 */
 	auto loc_start = Index (superpage_sequence.first ());
 	auto loc_end = Index (superpage_sequence.last ());
-	ASSERT_SAFE (loc_end.array_idx < table_size);
+	ASSERT_SAFE (superpage_sequence.last () <= table_size * BitArray::bits);
 	clear_bits (loc_start, loc_end);
 }
 
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::trim (const Range<size_t> & superpage_sequence) {
+inline void SuperpageTracker::trim (const Range<size_t> & superpage_sequence) {
 	/* Just clear the bits in the two tables.
 	 */
 	ASSERT_SAFE (superpage_sequence.size () > 1);
 	auto loc_start = Index (superpage_sequence.first ());
 	auto loc_end = Index (superpage_sequence.last ());
-	ASSERT_SAFE (loc_end.array_idx < table_size);
+	ASSERT_SAFE (superpage_sequence.last () <= table_size * BitArray::bits);
 	trim_bits (loc_start, loc_end);
 }
 
-template <typename Alloc>
-inline size_t SuperpageTracker<Alloc>::get_sequence_start_num (size_t superpage_num) const {
-	/* Find the first 0 in the sequence_table, looking backward from the starting position.
+inline void SuperpageTracker::split (const Range<size_t> & superpage_sequence) {
+	/* Mark every superpage as a sequence start ; mapping bits are unchanged.
+	 * Only the owner modifies these entries, so no atomic RMW is needed for start_table.
+	 */
+	ASSERT_SAFE (superpage_sequence.size () > 1);
+	auto loc_start = Index (superpage_sequence.first ());
+	auto loc_end = Index (superpage_sequence.last ());
+	ASSERT_SAFE (superpage_sequence.last () <= table_size * BitArray::bits);
+	clear_sequence_bits (loc_start.next (), loc_end);
+	for (auto num : superpage_sequence)
+		start_table[num].store (static_cast<StartNumType> (num), std::memory_order_relaxed);
+}
+
+inline size_t SuperpageTracker::get_sequence_start_num (size_t superpage_num) const {
+	/* Direct lookup in start_table.
 	 * Note that it won't check if the superpages are in the mapped table.
 	 */
-	auto loc = Index (superpage_num);
 	// TODO Assert if superpage is mapped ?
-	ASSERT_SAFE (loc.array_idx < table_size);
+	ASSERT_SAFE (superpage_num < start_table.size ());
+	return start_table[superpage_num].load (std::memory_order_relaxed);
+}
+
+inline void SuperpageTracker::update_full_summary (size_t array_idx) {
+	/* Set the summary bit to the fullness of the cell.
+	 * Concurrent updates of the same cell may write the summary in the wrong order, so check that
+	 * the cell state has not changed after writing it ; the last writer always leaves the summary
+	 * consistent with the cell.
+	 *
+	 * Orderings : summary RMWs are acq_rel, so they form a chain of synchronizations. The recheck
+	 * load cannot move before the RMW (acquire), and sees every cell modification made before a
+	 * previous summary RMW ; so the last RMW in modification order reflects the last cell state.
+	 */
+	auto & summary = full_summary_table[array_idx / BitArray::bits];
+	IntType bit = BitArray::one () << (array_idx % BitArray::bits);
+	bool full = mapping_table[array_idx].load (std::memory_order_relaxed) == BitArray::ones ();
 	while (true) {
-		IntType c = sequence_table[loc.array_idx].load (std::memory_order_seq_cst);
-		// Try to find preceeding zero
-		size_t prev_zero = BitArray::find_previous_zero (c, loc.bit_idx);
-		if (prev_zero != BitArray::bits)
-			return Index (loc.array_idx, prev_zero).superpage_num ();
-		// Continue search in previous word
-		loc = loc.prev_array_cell_last_bit ();
+		if (full)
+			summary.fetch_or (bit, std::memory_order_acq_rel);
+		else
+			summary.fetch_and (~bit, std::memory_order_acq_rel);
+		bool full_now = mapping_table[array_idx].load (std::memory_order_relaxed) == BitArray::ones ();
+		if (full_now == full)
+			return;
+		full = full_now;
+	}
+}
+
+inline size_t SuperpageTracker::next_non_full_cell (size_t array_idx,
+                                                    size_t end_array_idx) const {
+	// return : first cell index in [array_idx, end_array_idx] not marked full, or end_array_idx
+	size_t summary_idx = array_idx / BitArray::bits;
+	IntType s = full_summary_table[summary_idx].load (std::memory_order_relaxed);
+	IntType non_full = ~s & BitArray::window_bound (array_idx % BitArray::bits, BitArray::bits);
+	while (non_full == BitArray::zeros ()) {
+		summary_idx++;
+		if (summary_idx * BitArray::bits >= end_array_idx)
+			return end_array_idx;
+		non_full = ~full_summary_table[summary_idx].load (std::memory_order_relaxed);
 	}
+	return std::min (summary_idx * BitArray::bits + BitArray::count_lsb_zeros (non_full),
+	                 end_array_idx);
 }
 
-template <typename Alloc>
-inline bool SuperpageTracker<Alloc>::set_mapping_bits (Index loc_start, IntType expected_start,
-                                                       Index loc_end, IntType expected_end) {
+inline bool SuperpageTracker::set_mapping_bits (Index loc_start, IntType expected_start,
+                                                Index loc_end, IntType expected_end) {
 	ASSERT_SAFE (loc_start < loc_end);
 	if (loc_start.array_idx == loc_end.array_idx) {
 		// One cell span
-		return mapping_table[loc_start.array_idx].compare_exchange_strong (
-		    expected_start,
-		    expected_start | BitArray::window_bound (loc_start.bit_idx, loc_end.bit_idx),
-		    std::memory_order_seq_cst);
+		if (!mapping_table[loc_start.array_idx].compare_exchange_strong (
+		        expected_start,
+		        expected_start | BitArray::window_bound (loc_start.bit_idx, loc_end.bit_idx),
+		        std::memory_order_acquire, std::memory_order_relaxed))
+			return false;
+		update_full_summary (loc_start.array_idx);
+		return true;
 	} else {
 		/* Multicell span
 		 * Try to set bits (start, then middle, then end), revert to previous state on failure
 		 */
 		IntType loc_start_bits = BitArray::window_bound (loc_start.bit_idx, BitArray::bits);
 		if (mapping_table[loc_start.array_idx].compare_exchange_strong (
-		        expected_start, expected_start | loc_start_bits, std::memory_order_seq_cst)) {
+		        expected_start, expected_start | loc_start_bits, std::memory_order_acquire,
+		        std::memory_order_relaxed)) {
 			size_t idx;
 			for (idx = loc_start.array_idx + 1; idx < loc_end.array_idx; ++idx) {
 				IntType expected = BitArray::zeros ();
 				if (!mapping_table[idx].compare_exchange_strong (expected, BitArray::ones (),
-				                                                 std::memory_order_seq_cst))
+				                                                 std::memory_order_acquire,
+				                                                 std::memory_order_relaxed))
 					break;
 			}
 			if (idx == loc_end.array_idx) {
 				IntType loc_end_bits = BitArray::window_bound (0, loc_end.bit_idx);
-				if (loc_end_bits == BitArray::zeros ()) {
-					return true; // Nothing to do, setting bits is already a success
-				} else {
-					if (mapping_table[loc_end.array_idx].compare_exchange_strong (
-					        expected_end, expected_end | loc_end_bits, std::memory_order_seq_cst))
-						return true; // Success too
+				bool success = loc_end_bits == BitArray::zeros (); // Nothing to do for last cell
+				if (!success && mapping_table[loc_end.array_idx].compare_exchange_strong (
+				                    expected_end, expected_end | loc_end_bits, std::memory_order_acquire,
+				                    std::memory_order_relaxed)) {
+					update_full_summary (loc_end.array_idx);
+					success = true;
+				}
+				if (success) {
+					for (size_t i = loc_start.array_idx; i < loc_end.array_idx; ++i)
+						update_full_summary (i);
+					return true;
 				}
 			}
-			// Cleanup on failure
+			/* Cleanup on failure (summary was not updated yet).
+			 * Release : the next acquirer of these cells must still be ordered after their previous
+			 * owner, which we synchronized with.
+			 */
 			for (size_t clean_idx = loc_start.array_idx + 1; clean_idx < idx; ++clean_idx)
-				mapping_table[clean_idx].store (BitArray::zeros (), std::memory_order_seq_cst);
-			mapping_table[loc_start.array_idx].fetch_and (~loc_start_bits, std::memory_order_seq_cst);
+				mapping_table[clean_idx].store (BitArray::zeros (), std::memory_order_release);
+			mapping_table[loc_start.array_idx].fetch_and (~loc_start_bits, std::memory_order_release);
 		}
 		return false;
 	}
 }
 
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::clear_mapping_bits (Index loc_start, Index loc_end) {
+inline void SuperpageTracker::clear_mapping_bits (Index loc_start, Index loc_end) {
 	ASSERT_SAFE (loc_start < loc_end);
 	if (loc_start.array_idx == loc_end.array_idx) {
 		// One cell span
 		IntType bits = BitArray::window_bound (loc_start.bit_idx, loc_end.bit_idx);
-		mapping_table[loc_start.array_idx].fetch_and (~bits, std::memory_order_seq_cst);
+		mapping_table[loc_start.array_idx].fetch_and (~bits, std::memory_order_release);
+		update_full_summary (loc_start.array_idx);
 	} else {
 		// Multiple cells span
 		IntType first_cell_bits = BitArray::window_bound (loc_start.bit_idx, BitArray::bits);
 		IntType last_cell_bits = BitArray::window_bound (0, loc_end.bit_idx);
 
-		mapping_table[loc_start.array_idx].fetch_and (~first_cell_bits, std::memory_order_seq_cst);
+		mapping_table[loc_start.array_idx].fetch_and (~first_cell_bits, std::memory_order_release);
 		for (size_t i = loc_start.array_idx + 1; i < loc_end.array_idx; i++)
-			mapping_table[i].store (BitArray::zeros (), std::memory_order_seq_cst);
+			mapping_table[i].store (BitArray::zeros (), std::memory_order_release);
+		if (last_cell_bits != BitArray::zeros ())
+			mapping_table[loc_end.array_idx].fetch_and (~last_cell_bits, std::memory_order_release);
+
+		for (size_t i = loc_start.array_idx; i < loc_end.array_idx; i++)
+			update_full_summary (i);
 		if (last_cell_bits != BitArray::zeros ())
-			mapping_table[loc_end.array_idx].fetch_and (~last_cell_bits, std::memory_order_seq_cst);
+			update_full_summary (loc_end.array_idx);
 	}
 }
 
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::set_sequence_bits (Index loc_start, Index loc_end) {
+inline void SuperpageTracker::set_sequence_bits (Index loc_start, Index loc_end) {
 	// No need to compare_exchange ; we are supposed to own the sequence bits as we reserved the
 	// area through mapping bits
 	ASSERT_SAFE (loc_start <= loc_end);
@@ -320,60 +459,60 @@ inline void SuperpageTracker<Alloc>::set_sequence_bits (Index loc_start, Index l
 		// One cell span
 		if (loc_start.bit_idx < loc_end.bit_idx) {
 			IntType bits = BitArray::window_bound (loc_start.bit_idx, loc_end.bit_idx);
-			sequence_table[loc_start.array_idx].fetch_or (bits, std::memory_order_seq_cst);
+			sequence_table[loc_start.array_idx].fetch_or (bits, std::memory_order_relaxed);
 		}
 	} else {
 		// Multiple cell span
 		IntType first_cell_bits = BitArray::window_bound (loc_start.bit_idx, BitArray::bits);
 		IntType last_cell_bits = BitArray::window_bound (0, loc_end.bit_idx);
 
-		sequence_table[loc_start.array_idx].fetch_or (first_cell_bits, std::memory_order_seq_cst);
+		sequence_table[loc_start.array_idx].fetch_or (first_cell_bits, std::memory_order_relaxed);
 		for (size_t i = loc_start.array_idx + 1; i < loc_end.array_idx; i++)
-			sequence_table[i].store (BitArray::ones (), std::memory_order_seq_cst);
+			sequence_table[i].store (BitArray::ones (), std::memory_order_relaxed);
 		if (last_cell_bits != BitArray::zeros ())
-			sequence_table[loc_end.array_idx].fetch_or (last_cell_bits, std::memory_order_seq_cst);
+			sequence_table[loc_end.array_idx].fetch_or (last_cell_bits, std::memory_order_relaxed);
 	}
 }
 
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::clear_sequence_bits (Index loc_start, Index loc_end) {
+inline void SuperpageTracker::clear_sequence_bits (Index loc_start, Index loc_end) {
 	ASSERT_SAFE (loc_start <= loc_end);
 	if (loc_start.array_idx == loc_end.array_idx) {
 		// One cell span
 		if (loc_start.bit_idx < loc_end.bit_idx) {
 			IntType bits = BitArray::window_bound (loc_start.bit_idx, loc_end.bit_idx);
-			sequence_table[loc_start.array_idx].fetch_and (~bits, std::memory_order_seq_cst);
+			sequence_table[loc_start.array_idx].fetch_and (~bits, std::memory_order_relaxed);
 		}
 	} else {
 		// Multiple cells span
 		IntType first_cell_bits = BitArray::window_bound (loc_start.bit_idx, BitArray::bits);
 		IntType last_cell_bits = BitArray::window_bound (0, loc_end.bit_idx);
 
-		sequence_table[loc_start.array_idx].fetch_and (~first_cell_bits, std::memory_order_seq_cst);
+		sequence_table[loc_start.array_idx].fetch_and (~first_cell_bits, std::memory_order_relaxed);
 		for (size_t i = loc_start.array_idx + 1; i < loc_end.array_idx; i++)
-			sequence_table[i].store (BitArray::zeros (), std::memory_order_seq_cst);
+			sequence_table[i].store (BitArray::zeros (), std::memory_order_relaxed);
 		if (last_cell_bits != BitArray::zeros ())
-			sequence_table[loc_end.array_idx].fetch_and (~last_cell_bits, std::memory_order_seq_cst);
+			sequence_table[loc_end.array_idx].fetch_and (~last_cell_bits, std::memory_order_relaxed);
 	}
 }
 
-template <typename Alloc>
-inline bool SuperpageTracker<Alloc>::set_bits (Index loc_start, IntType expected_start,
-                                               Index loc_end, IntType expected_end) {
-	/* Sets bits to release a superpage sequence.
-	 * mapping_table is set first, then sequence_table if we were successful.
+inline bool SuperpageTracker::set_bits (Index loc_start, IntType expected_start,
+                                        Index loc_end, IntType expected_end) {
+	/* Sets bits to acquire a superpage sequence.
+	 * mapping_table is set first, then sequence_table and start_table if we were successful.
 	 * set_sequence_bits lets the first bit as 0 to mark the start of sequence.
 	 */
 	if (set_mapping_bits (loc_start, expected_start, loc_end, expected_end)) {
 		set_sequence_bits (loc_start.next (), loc_end);
+		auto start_num = static_cast<StartNumType> (loc_start.superpage_num ());
+		for (size_t num = loc_start.superpage_num (); num < loc_end.superpage_num (); ++num)
+			start_table[num].store (start_num, std::memory_order_relaxed);
 		return true;
 	} else {
 		return false;
 	}
 }
 
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::clear_bits (Index loc_start, Index loc_end) {
+inline void SuperpageTracker::clear_bits (Index loc_start, Index loc_end) {
 	/* Clears bits to release a superpage sequence.
 	 * sequence_table is cleared first, then mapping_table.
 	 * we do not clear the start_of_sequence 0 bit (useless).
@@ -382,8 +521,7 @@ inline void SuperpageTracker<Alloc>::clear_bits (Index loc_start, Index loc_end)
 	clear_mapping_bits (loc_start, loc_end);
 }
 
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::trim_bits (Index loc_start, Index loc_end) {
+inline void SuperpageTracker::trim_bits (Index loc_start, Index loc_end) {
 	/* Clears bits to trim a superpage sequence to 1 superpage.
 	 * sequence_table is cleared first, then mapping_table.
 	 */
@@ -392,9 +530,8 @@ inline void SuperpageTracker<Alloc>::trim_bits (Index loc_start, Index loc_end)
 }
 
 #ifdef ASSERT_SAFE_ENABLED
-template <typename Alloc>
-inline void SuperpageTracker<Alloc>::print (size_t nb_node, size_t superpage_by_node,
-                                            int superpage_by_line) const {
+inline void SuperpageTracker::print (size_t nb_node, size_t superpage_by_node,
+                                     int superpage_by_line) const {
 	const int indicator_interval = 10;
 	const int line_prefix_size = 10;
 	ASSERT_SAFE (superpage_by_line > 0);
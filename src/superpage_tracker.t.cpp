@@ -1,7 +1,6 @@
 #define ASSERT_LEVEL_SAFE
 
 #include "superpage_tracker.h"
-#include "block.h"
 #include "tests.h"
 
 using namespace Givy;
@@ -10,18 +9,11 @@ void sep (void) {
 	printf ("\n---------------------------------------------------------\n");
 }
 
-struct SystemAlloc {
-	// For testing only...
-	Block allocate (size_t size, size_t) { return {new char[size], size}; }
-	void deallocate (Block blk) { delete[] static_cast<char*> (blk.ptr); }
-};
-
 int main (void) {
-	SystemAlloc alloc;
 	const size_t nb_node = 3;
 	const size_t superpage_by_node = 200;
 	const auto local_range = range_from_offset (superpage_by_node, superpage_by_node);
-	SuperpageTracker<SystemAlloc> tracker (superpage_by_node * nb_node, alloc);
+	SuperpageTracker tracker (superpage_by_node * nb_node);
 
 	auto acq = [&] (size_t n) { return tracker.acquire (n, local_range); };
 	auto trim = [&] (auto && r) { tracker.trim (r); };
@@ -52,9 +44,11 @@ int main (void) {
 		print ();
 		printf ("%zu %zu %zu %zu\n", s4, s5, s6, s7);
 
-		// Check results of header finding
-		for (size_t s = 0; s < 100; s += 10)
+		// Check results of header finding (in the acquired part of the local range)
+		for (size_t s = local_range.first (); s < local_range.first () + 100; s += 10)
 			printf ("Header of %zu = %zu\n", s, tracker.get_sequence_start_num (s));
+		for (size_t s = s3; s < s3 + 70; ++s)
+			ASSERT_STD (tracker.get_sequence_start_num (s) == s3);
 
 		// Test trimming
 		printf ("Trimming\n");
@@ -72,6 +66,44 @@ int main (void) {
 		print ();
 	}
 	sep ();
+	{
+		// Full cells are skipped using the summary ; freed space behind them must still be found
+		printf ("Summary of full cells\n");
+		const size_t big_node = 64 * 64 * 2;
+		const auto big_range = range_from_offset (size_t (0), big_node);
+		SuperpageTracker big_tracker (big_node);
+		size_t filler = big_tracker.acquire (big_node - 100, big_range);
+		size_t last = big_tracker.acquire (100, big_range);
+		ASSERT_STD (filler == 0);
+		ASSERT_STD (last == big_node - 100);
+		big_tracker.release (range_from_offset (last, 100));
+		big_tracker.release (range_from_offset (filler, big_node - 100));
+		size_t a = big_tracker.acquire (64 * 64 + 10, big_range);
+		size_t b = big_tracker.acquire (1, big_range);
+		big_tracker.release (range_from_offset (a, 64 * 64 + 10));
+		size_t c = big_tracker.acquire (64, big_range);
+		printf ("%zu %zu %zu %zu %zu\n", filler, last, a, b, c);
+		ASSERT_STD (a == 0);
+		ASSERT_STD (b == 64 * 64 + 10);
+		ASSERT_STD (c == 0);
+	}
+	sep ();
+	{
+		// A split sequence is made of independent 1 superpage sequences
+		printf ("Split\n");
+		size_t s = acq (16);
+		tracker.split (range_from_offset (s, 16));
+		for (size_t i = 0; i < 16; ++i)
+			ASSERT_STD (tracker.get_sequence_start_num (s + i) == s + i);
+		rel (range_from_offset (s + 3, 1));
+		rel (range_from_offset (s + 8, 8));
+		print ();
+		ASSERT_STD (acq (8) == s + 8);
+		rel (range_from_offset (s + 8, 8));
+		rel (range_from_offset (s, 3));
+		rel (range_from_offset (s + 4, 4));
+	}
+	sep ();
 	{
 		// Test parallel modifications (may fail spuriously if too much contention)
 		constexpr int nb_th = 4;
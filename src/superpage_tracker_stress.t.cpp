@@ -0,0 +1,91 @@
+#define ASSERT_LEVEL_SAFE
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "superpage_tracker.h"
+#include "tests.h"
+
+using namespace Givy;
+
+/* Concurrent acquire/trim/release/lookup interleavings on a SuperpageTracker.
+ * Each thread checks that :
+ * - acquired superpages are not owned by anyone else (ownership table, exchanged on acquire),
+ * - lookups of any superpage of its sequences give the sequence start, before and after trim.
+ * Sequence sizes cross tracker cell boundaries, to exercise the multi-cell paths.
+ * Build with "make tsan_superpage_tracker_stress" to run under ThreadSanitizer.
+ */
+
+namespace {
+constexpr size_t nb_thread = 8;
+constexpr size_t nb_round = 200000;
+constexpr size_t superpage_nb = 64 * 32;
+
+std::array<std::atomic<size_t>, superpage_nb> owner; // 0 if free, else thread id + 1
+
+size_t next_rand (size_t & state) {
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+}
+
+int main (void) {
+	SuperpageTracker tracker (superpage_nb);
+	const auto space = range (superpage_nb);
+	for (auto & o : owner)
+		o = 0;
+
+	std::atomic<size_t> errors{0};
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nb_thread; ++t)
+		threads.emplace_back ([&](size_t thid) {
+			size_t rng = thid + 1;
+			size_t cursor = thid * 64;
+			size_t me = thid + 1;
+			for (size_t round = 0; round < nb_round; ++round) {
+				// Mostly small sequences, sometimes spanning several cells
+				size_t r = next_rand (rng);
+				size_t n = (r % 16 == 0) ? 1 + (r >> 8) % 150 : 1 + (r >> 8) % 4;
+				size_t s = (round % 2) ? tracker.acquire (n, space, cursor) : tracker.acquire (n, space);
+				cursor = (s + n) % superpage_nb;
+
+				for (size_t i = s; i < s + n; ++i)
+					if (owner[i].exchange (me, std::memory_order_relaxed) != 0)
+						errors++;
+				for (size_t i = s; i < s + n; ++i)
+					if (tracker.get_sequence_start_num (i) != s)
+						errors++;
+
+				if (n > 1 && next_rand (rng) % 4 == 0) {
+					for (size_t i = s + 1; i < s + n; ++i)
+						owner[i].store (0, std::memory_order_relaxed);
+					tracker.trim (range_from_offset (s, n));
+					n = 1;
+					if (tracker.get_sequence_start_num (s) != s)
+						errors++;
+				}
+
+				for (size_t i = s; i < s + n; ++i)
+					if (owner[i].exchange (0, std::memory_order_relaxed) != me)
+						errors++;
+				tracker.release (range_from_offset (s, n));
+			}
+		}, t);
+	for (auto & th : threads)
+		th.join ();
+
+	printf ("SuperpageTracker stress: %zu threads x %zu rounds, %zu errors\n", nb_thread, nb_round,
+	        errors.load ());
+	ASSERT_STD (errors == 0);
+
+	// Everything was released : the whole space must be acquirable at once
+	size_t all = tracker.acquire (superpage_nb, space);
+	ASSERT_STD (all == 0);
+	tracker.release (range_from_offset (all, superpage_nb));
+	return 0;
+}
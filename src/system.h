@@ -2,6 +2,7 @@
 #ifndef GIVY_SYSTEM_H
 #define GIVY_SYSTEM_H
 
+#include <cstdint>  // uintptr_t
 #include <unistd.h> // sysconf
 
 #include "reporting.h"
@@ -19,8 +20,13 @@ namespace VMem {
 	constexpr size_t superpage_shift = page_shift + 9;
 	constexpr size_t superpage_size = 1 << superpage_shift;
 	constexpr size_t superpage_page_nb = 1 << (superpage_shift - page_shift);
+	// Cache line (not checked at runtime)
+	constexpr size_t cache_line_size = 64;
+	// End of user space addresses (x86_64, 4-level page tables)
+	constexpr uintptr_t user_space_end = uintptr_t (1) << 47;
 	// Some checks
 	static_assert (superpage_size > page_size, "superpage_size <= page_size");
+	static_assert (page_size % cache_line_size == 0, "page_size not a multiple of cache lines");
 	inline void runtime_asserts (void) { ASSERT_STD (sysconf (_SC_PAGESIZE) == page_size); }
 }
 
@@ -2,8 +2,10 @@
 #ifndef GIVY_TYPES_H
 #define GIVY_TYPES_H
 
-#include <cstdint> // uintN_t
-#include <utility> // std::forward
+#include <cstdint>     // uintN_t
+#include <new>         // placement new
+#include <type_traits> // std::aligned_storage
+#include <utility>     // std::forward
 
 #include "math.h"
 #include "reporting.h" // for container
@@ -34,6 +36,24 @@ template <typename T, typename... Args> inline void construct (T & t, Args &&...
 template <typename T> inline void destruct (T & t) {
 	t.~T ();
 }
+
+/* Storage for a T constructed and destructed manually (used for runtime structures initialized late).
+ */
+template <typename T> class Constructible {
+private:
+	typename std::aligned_storage<sizeof (T), alignof (T)>::type storage;
+
+public:
+	template <typename... Args> void construct (Args &&... args) {
+		new (&storage) T (std::forward<Args> (args)...);
+	}
+	void destruct (void) { object ().~T (); }
+
+	T & object (void) { return *reinterpret_cast<T *> (&storage); }
+	const T & object (void) const { return *reinterpret_cast<const T *> (&storage); }
+	T * operator-> (void) { return &object (); }
+	const T * operator-> (void) const { return &object (); }
+};
 }
 
 #endif
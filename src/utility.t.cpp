@@ -3,9 +3,9 @@
 #include <iostream>
 #include <limits>
 
+#include "bitmask.h"
 #include "types.h"
 
-
 using namespace Givy;
 
 template <size_t N = 1> void test_bound_uint (void) {
@@ -17,8 +17,39 @@ template <size_t N = 1> void test_bound_uint (void) {
 template <> void test_bound_uint<0> (void) {}
 template <> void test_bound_uint<(size_t (1) << 33)> (void) {}
 
+template <typename IntType> void test_bitmask (void) {
+	// Compare against bit by bit references on pseudo random words
+	using BM = BitMask<IntType>;
+	uint64_t state = 42;
+	size_t nb_checks = 0;
+	for (int i = 0; i < 2000; ++i) {
+		state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+		// Sparse ones to have long zero runs
+		IntType c = static_cast<IntType> (state & (state >> 7) & (state >> 23));
+
+		size_t nb_zeros = 0;
+		for (size_t b = 0; b < BM::bits; ++b)
+			nb_zeros += !BM::is_set (c, b);
+		ASSERT_STD (BM::count_zeros (c) == nb_zeros);
+
+		for (size_t from = 0; from < BM::bits; from += 5)
+			for (size_t up_to = from; up_to <= BM::bits; up_to += 3)
+				for (size_t len = 0; from + len <= up_to; ++len) {
+					size_t expected = BM::bits;
+					for (size_t pos = from; pos + len <= up_to && expected == BM::bits; ++pos)
+						if ((c & BM::window_size (pos, len)) == BM::zeros ())
+							expected = pos;
+					ASSERT_STD (BM::find_zero_subsequence (c, len, from, up_to) == expected);
+					nb_checks++;
+				}
+	}
+	std::cout << "BitMask<" << BitMask<IntType>::bits << ">: " << nb_checks << " checks ok\n";
+}
+
 int main (void) {
 	test_bound_uint ();
+	test_bitmask<uint8_t> ();
+	test_bitmask<uint64_t> ();
 
 	return 0;
 }